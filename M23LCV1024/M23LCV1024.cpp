@@ -53,6 +53,12 @@ static void spiSend(const uint8_t* buf , size_t n) {
     SPI.transfer(buf[i]);
   }
 }
+//------------------------------------------------------------------------------
+static void spiFill(uint8_t value, uint32_t n) {
+  for (; n; n--) {
+    SPI.transfer(value);
+  }
+}
 //==============================================================================
 #else  // SRAM_USE_SPI_LIB
 #include <DigitalPin.h>
@@ -103,6 +109,13 @@ static void spiSend(const uint8_t* buf , size_t n) {
   }
   while (!(SPSR & (1 << SPIF))) {}
 }
+//------------------------------------------------------------------------------
+static void spiFill(uint8_t value, uint32_t n) {
+  for (; n; n--) {
+    SPDR = value;
+    while (!(SPSR & (1 << SPIF))) {}
+  }
+}
 #endif  // SRAM_USE_SPI_LIB
 //==============================================================================
 bool M23LCV1024::begin(uint8_t* csPin, uint8_t chipCount) {
@@ -143,6 +156,20 @@ bool M23LCV1024::begin(uint8_t* csPin, uint8_t chipCount) {
   }
 }
 //------------------------------------------------------------------------------
+bool M23LCV1024::fill(uint32_t address, uint8_t value, uint32_t length) {
+  while (length) {
+    // Sequential access wraps at the end of a chip.
+    uint32_t n = 0X20000 - (address & 0X1FFFF);
+    if (n > length) n = length;
+    if (!sendCmdAddress(WRITE_DATA, address)) return false;
+    spiFill(value, n);
+    csHigh();
+    address += n;
+    length -= n;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
 bool M23LCV1024::read(uint32_t address, void *buf, size_t nbyte) {
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
   if (!sendCmdAddress(READ_DATA, address)) return false;
@@ -57,6 +57,14 @@ class M23LCV1024 : public RamBaseDevice {
    */
   bool begin(uint8_t csPin) {return begin(&csPin, 1);}
 
+  /** Set a range of the M23LCV1024 to a value.
+   * \param[in] address start location in the M23LCV1024.
+   * \param[in] value value for each byte.
+   * \param[in] length number of bytes to fill.
+   * \return true unless address is out of range.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length);
+
   /** Read a block from the 23LCV1024.
    * \param[in] address start location in the 23LCV1024.
    * \param[out] buf location in Arduino SRAM for the transfer.
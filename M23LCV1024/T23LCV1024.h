@@ -53,6 +53,19 @@ class T23LCV1024 : public RamBaseDevice {
     cspin.high();
   }
   //----------------------------------------------------------------------------
+  /** Set a range of the 23LCV1024 to a value.
+   * \param[in] address start location in the 23LCV1024.
+   * \param[in] value value for each byte.
+   * \param[in] length number of bytes to fill.
+   * \return Always returns true.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    sendCmdAddress(WRITE_DATA, address);
+    for (; length; length--) spiSend(value);
+    cspin.high();
+    return true;
+  }
+  //----------------------------------------------------------------------------
   /** Read a block from the 23LCV1024.
    * \param[in] address start location in the 23LCV1024.
    * \param[out] buf location in Arduino SRAM for the transfer.
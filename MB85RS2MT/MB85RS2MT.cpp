@@ -53,6 +53,12 @@ static void spiSend(const uint8_t* buf , size_t n) {
     SPI.transfer(buf[i]);
   }
 }
+//------------------------------------------------------------------------------
+static void spiFill(uint8_t value, uint32_t n) {
+  for (; n; n--) {
+    SPI.transfer(value);
+  }
+}
 //==============================================================================
 #else  // FRAM_USE_SPI_LIB
 #include <DigitalPin.h>
@@ -103,6 +109,13 @@ static void spiSend(const uint8_t* buf , size_t n) {
   }
   while (!(SPSR & (1 << SPIF))) {}
 }
+//------------------------------------------------------------------------------
+static void spiFill(uint8_t value, uint32_t n) {
+  for (; n; n--) {
+    SPDR = value;
+    while (!(SPSR & (1 << SPIF))) {}
+  }
+}
 #endif  // FRAM_USE_SPI_LIB
 //==============================================================================
 
@@ -136,6 +149,20 @@ bool MB85RS2MT::begin(uint8_t* csPin, uint8_t chipCount) {
 #endif  // FRAM_USE_SPI_LIB
 }
 //------------------------------------------------------------------------------
+bool MB85RS2MT::fill(uint32_t address, uint8_t value, uint32_t length) {
+  while (length) {
+    // Sequential access wraps at the end of a chip.
+    uint32_t n = 0X40000 - (address & 0X3FFFF);
+    if (n > length) n = length;
+    if (!sendCmdAddress(MB85RS_WRITE, address)) return false;
+    spiFill(value, n);
+    csHigh();
+    address += n;
+    length -= n;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
 bool MB85RS2MT::read(uint32_t address, void *buf, size_t nbyte) {
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
   if (!sendCmdAddress(MB85RS_READ, address)) return false;
@@ -56,6 +56,14 @@ class MB85RS2MT : public RamBaseDevice {
    */
   bool begin(uint8_t csPin) {return begin(&csPin, 1);}
 
+  /** Set a range of the MB85RS2MT to a value.
+   * \param[in] address start location in the MB85RS2MT.
+   * \param[in] value value for each byte.
+   * \param[in] length number of bytes to fill.
+   * \return true unless address is out of range.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length);
+
   /** Read a block from the MB85RS2MT.
    * \param[in] address start location in the MB85RS2MT.
    * \param[out] buf location in Arduino SRAM for the transfer.
@@ -40,6 +40,19 @@ class T_MB85RS2MT : public RamBaseDevice {
     spiBegin();
   }
   //----------------------------------------------------------------------------
+  /** Set a range of the MB85RS2MT to a value.
+   * \param[in] address start location in the MB85RS2MT.
+   * \param[in] value value for each byte.
+   * \param[in] length number of bytes to fill.
+   * \return Always returns true.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    sendCmdAddress(MB85RS_WRITE, address);
+    for (; length; length--) spiSend(value);
+    cspin.high();
+    return true;
+  }
+  //----------------------------------------------------------------------------
   /** Read a block from the MB85RS2MT.
    * \param[in] address start location in the MB85RS2MT.
    * \param[out] buf location in Arduino SRAM for the transfer.
@@ -0,0 +1,521 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef CompressedRamDevice_h
+#define CompressedRamDevice_h
+/**
+ * \file
+ * CompressedRamDevice class
+ */
+#include <RamBaseDevice.h>
+//------------------------------------------------------------------------------
+/** Value of CompressedHeader::magic. */
+const uint32_t COMPRESSED_RAM_MAGIC = 0X435A5244;
+/** Bytes in a storage chunk including the two byte link. */
+const uint16_t COMPRESSED_CHUNK_SIZE = 64;
+/** Link value for the last chunk of a chain. */
+const uint16_t COMPRESSED_CHUNK_END = 0XFFFF;
+//------------------------------------------------------------------------------
+/**
+ * \struct CompressedHeader
+ * \brief Header at address zero of the backing device.
+ *
+ * Fields are ordered so the layout is the same on all boards.
+ */
+struct CompressedHeader {
+  /** COMPRESSED_RAM_MAGIC */
+  uint32_t magic;
+  /** Number of units in the logical device. */
+  uint32_t unitCount;
+  /** Number of 512 byte blocks stored uncompressed before the units. */
+  uint32_t rawBlocks;
+  /** Size of a unit in bytes. */
+  uint16_t unitSize;
+  /** Number of storage chunks. */
+  uint16_t chunkCount;
+  /** First free chunk or COMPRESSED_CHUNK_END. */
+  uint16_t freeHead;
+  /** Number of free chunks. */
+  uint16_t freeCount;
+}__attribute__((packed));
+static_assert(sizeof(CompressedHeader) == 20, "CompressedHeader size");
+//------------------------------------------------------------------------------
+/**
+ * \struct CompressedMapEntry
+ * \brief Location of a unit in the backing device.
+ */
+struct CompressedMapEntry {
+  /** First chunk of the unit's chain. */
+  uint16_t chunk;
+  /** Stored length, zero for a unit of zeros, unit size if not compressed. */
+  uint16_t length;
+}__attribute__((packed));
+static_assert(sizeof(CompressedMapEntry) == 4, "CompressedMapEntry size");
+//------------------------------------------------------------------------------
+/**
+ * \class CompressedRamDevice
+ * \brief Store compressed units of a larger logical device.
+ *
+ * The first rawBlocks blocks of the logical device are stored as is on
+ * the backing device.  Use the volume's RamVolume::dataStartBlock() so
+ * the parameters, FAT and directory are not compressed.  Their small
+ * writes then cost the same as on the backing device.
+ *
+ * The rest of the logical device is divided into units, normally one
+ * cluster of the volume.  Each unit is compressed with a small LZ77
+ * coder and stored in a chain of COMPRESSED_CHUNK_SIZE byte chunks on
+ * the backing device.  A map on the backing device holds the first chunk
+ * and length of each unit.  Units of zeros use no chunks.
+ *
+ * One unit is kept uncompressed in Arduino SRAM.  Reads and writes of
+ * that unit do not access the backing device.  The unit is compressed
+ * and stored when another unit is accessed or flush() is called.  A file
+ * written sequentially is compressed once per unit.  Call flush() after
+ * RamBaseFile::sync() if the backing device is persistent.  Each flush()
+ * stores the whole unit again so flush only as often as data must
+ * survive a reset.  A reset during flush() may leave chunks that belong
+ * to no unit but never gives a chunk to two units.
+ *
+ * The logical size is set by format().  Writes fail if the backing device
+ * runs out of chunks so choose a size from the expected compression ratio.
+ *
+ * \tparam Unit Unit size in bytes, a multiple of 512 no larger than 2048.
+ * Two buffers of Unit bytes are used.
+ */
+template<uint16_t Unit = 512>
+class CompressedRamDevice : public RamBaseDevice {
+ public:
+  /** Create a device.  Calls fail until begin() or format() succeeds. */
+  CompressedRamDevice() : m_dev(0) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Initialize a device previously created by format().
+   *
+   * \param[in] dev Backing device.
+   *
+   * \return true for success or false for failure.
+   */
+  bool begin(RamBaseDevice* dev) {
+    m_dev = 0;
+    if (!dev->read(0, &m_header, sizeof(m_header))) return false;
+    if (m_header.magic != COMPRESSED_RAM_MAGIC
+        || m_header.unitSize != Unit || m_header.unitCount == 0) {
+      return false;
+    }
+    m_dev = dev;
+    m_unit = NO_UNIT;
+    m_dirty = false;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Fill a region of the logical device.
+   *
+   * \param[in] address Start of the region.
+   *
+   * \param[in] value Value stored in each byte.
+   *
+   * \param[in] length Number of bytes in the region.
+   *
+   * \return true for success or false for failure.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    if (!m_dev) return false;
+    if (address < rawBytes()) {
+      uint32_t n = rawBytes() - address;
+      if (n > length) n = length;
+      if (!m_dev->fill(rawStart() + address, value, n)) return false;
+      address += n;
+      length -= n;
+    }
+    return RamBaseDevice::fill(address, value, length);
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Create an empty logical device of zeros.
+   *
+   * \param[in] dev Backing device.
+   *
+   * \param[in] logicalBlocks Size of the logical device in 512 byte blocks.
+   *
+   * \param[in] rawBlocks Blocks at the start of the logical device that are
+   *            not compressed.
+   *
+   * \return true for success or false for failure.
+   */
+  bool format(RamBaseDevice* dev, uint32_t logicalBlocks,
+              uint32_t rawBlocks = 0) {
+    uint32_t n;
+    uint16_t chunks;
+    m_dev = 0;
+    if (rawBlocks >= logicalBlocks) return false;
+    m_header.unitCount = (logicalBlocks - rawBlocks)/(Unit/512);
+    m_header.rawBlocks = rawBlocks;
+    uint32_t start = chunkAddress(0);
+    if (m_header.unitCount == 0 || start >= 512UL*dev->sizeBlocks()) {
+      return false;
+    }
+    n = (512UL*dev->sizeBlocks() - start)/COMPRESSED_CHUNK_SIZE;
+    chunks = n < COMPRESSED_CHUNK_END ? n : COMPRESSED_CHUNK_END - 1;
+    if (!dev->fill(sizeof(m_header), 0, 4*m_header.unitCount)
+        || !dev->fill(rawStart(), 0, rawBytes())) {
+      return false;
+    }
+    for (uint16_t i = 0; i < chunks; i++) {
+      uint16_t next = i + 1 < chunks ? i + 1 : COMPRESSED_CHUNK_END;
+      if (!dev->write(start + (uint32_t)i*COMPRESSED_CHUNK_SIZE,
+                      &next, sizeof(next))) {
+        return false;
+      }
+    }
+    m_header.magic = COMPRESSED_RAM_MAGIC;
+    m_header.unitSize = Unit;
+    m_header.chunkCount = chunks;
+    m_header.freeHead = 0;
+    m_header.freeCount = chunks;
+    if (!dev->write(0, &m_header, sizeof(m_header))) return false;
+    return begin(dev);
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Compress and store the unit in Arduino SRAM if it has changed.
+   *
+   * \return true for success or false for failure.
+   */
+  bool flush() {
+    CompressedMapEntry old;
+    CompressedMapEntry entry;
+    const uint8_t* src = m_tmp;
+    if (!m_dirty) return true;
+    entry.chunk = COMPRESSED_CHUNK_END;
+    entry.length = 0;
+    for (uint16_t i = 0; i < Unit; i++) {
+      if (m_buf[i]) {
+        entry.length = compress(m_buf, m_tmp);
+        if (entry.length == 0) {
+          // Store a unit that does not compress as is.
+          entry.length = Unit;
+          src = m_buf;
+        }
+        break;
+      }
+    }
+    if (!m_dev->read(mapAddress(m_unit), &old, sizeof(old))
+        || old.length > Unit) {
+      return false;
+    }
+    uint16_t count = chainLength(entry.length);
+    // Fail with no change if the new chain can't fit.
+    if (count > m_header.freeCount + chainLength(old.length)) return false;
+    // Write the new chain before freeing the old chain if space allows.
+    if (count > m_header.freeCount) {
+      // Mark the unit empty first so the old chain is never freed twice.
+      CompressedMapEntry empty = {COMPRESSED_CHUNK_END, 0};
+      if (!m_dev->write(mapAddress(m_unit), &empty, sizeof(empty))
+          || !freeChain(old)) {
+        return false;
+      }
+      old.length = 0;
+    }
+    if (!writeChain(&entry, src)) return false;
+    // Save the free list before the map points at its chunks.
+    if (!m_dev->write(0, &m_header, sizeof(m_header))
+        || !m_dev->write(mapAddress(m_unit), &entry, sizeof(entry))) {
+      return false;
+    }
+    if (old.length) {
+      if (!freeChain(old)
+          || !m_dev->write(0, &m_header, sizeof(m_header))) {
+        return false;
+      }
+    }
+    m_dirty = false;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of bytes available for compressed data. */
+  uint32_t freeBytes() {
+    return m_dev ? (uint32_t)m_header.freeCount*(COMPRESSED_CHUNK_SIZE - 2)
+                 : 0;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Read data from the logical device.
+   *
+   * \param[in] address Location to be read.
+   *
+   * \param[out] buf Pointer to the location that will receive the data.
+   *
+   * \param[in] nbyte Number of bytes to read.
+   *
+   * \return true for success or false for failure.
+   */
+  bool read(uint32_t address, void *buf, size_t nbyte) {
+    uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+    if (!m_dev) return false;
+    while (nbyte) {
+      size_t n = span(address, nbyte);
+      if (address < rawBytes()) {
+        if (!m_dev->read(rawStart() + address, dst, n)) return false;
+      } else {
+        uint32_t a = address - rawBytes();
+        if (!select(a/Unit, true)) return false;
+        memcpy(dst, m_buf + a % Unit, n);
+      }
+      address += n;
+      dst += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Size of the logical device in 512 byte blocks. */
+  uint32_t sizeBlocks() {
+    return m_dev ? m_header.rawBlocks + m_header.unitCount*(Unit/512) : 0;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Write data to the logical device.
+   *
+   * \param[in] address Location to be written.
+   *
+   * \param[in] buf Pointer to the location of the data to be written.
+   *
+   * \param[in] nbyte Number of bytes to write.
+   *
+   * \return true for success or false for failure.
+   */
+  bool write(uint32_t address, const void *buf, size_t nbyte) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
+    if (!m_dev) return false;
+    while (nbyte) {
+      size_t n = span(address, nbyte);
+      if (address < rawBytes()) {
+        if (!m_dev->write(rawStart() + address, src, n)) return false;
+      } else {
+        uint32_t a = address - rawBytes();
+        // No need to load a unit that will be replaced.
+        if (!select(a/Unit, n < Unit)) return false;
+        memcpy(m_buf + a % Unit, src, n);
+        m_dirty = true;
+      }
+      address += n;
+      src += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+
+ private:
+  static const uint32_t NO_UNIT = 0XFFFFFFFF;
+  static const uint8_t HASH_BITS = 7;
+  static const uint16_t MAX_OFFSET = 2048;
+  static const uint16_t MAX_MATCH = 18 + 255;
+  //----------------------------------------------------------------------------
+  // Match token 1LLLLHHH then offset low byte then, if LLLL is 15, an extra
+  // length byte.  Length is LLLL + 3 plus the extra byte and offset is
+  // HHH:low + 1.  Literal token 0LLLLLLL is followed by LLLLLLL + 1 bytes.
+  // Return compressed length or zero if the unit does not compress.
+  static uint16_t compress(const uint8_t* in, uint8_t* out) {
+    uint16_t table[1 << HASH_BITS];
+    uint16_t i = 0;
+    uint16_t lit = 0;
+    uint16_t n = 0;
+    memset(table, 0XFF, sizeof(table));
+    while (i + 3 <= Unit) {
+      uint16_t h = hash(in + i);
+      uint16_t cand = table[h];
+      table[h] = i;
+      if (cand == 0XFFFF || i - cand > MAX_OFFSET
+          || memcmp(in + cand, in + i, 3)) {
+        i++;
+        continue;
+      }
+      uint16_t len = 3;
+      while (i + len < Unit && len < MAX_MATCH
+             && in[cand + len] == in[i + len]) {
+        len++;
+      }
+      if (!literals(in + lit, i - lit, out, &n)) return 0;
+      uint16_t off = i - cand - 1;
+      if (n + 3 >= Unit) return 0;
+      if (len < 18) {
+        out[n++] = 0X80 | ((len - 3) << 3) | (off >> 8);
+        out[n++] = off;
+      } else {
+        out[n++] = 0XF8 | (off >> 8);
+        out[n++] = off;
+        out[n++] = len - 18;
+      }
+      i += len;
+      lit = i;
+    }
+    if (!literals(in + lit, Unit - lit, out, &n)) return 0;
+    return n;
+  }
+  //----------------------------------------------------------------------------
+  static bool decompress(const uint8_t* in, uint16_t length, uint8_t* out) {
+    uint16_t i = 0;
+    uint16_t n = 0;
+    while (i < length) {
+      uint8_t t = in[i++];
+      if (t < 0X80) {
+        uint16_t k = t + 1;
+        if (i + k > length || n + k > Unit) return false;
+        memcpy(out + n, in + i, k);
+        i += k;
+        n += k;
+        continue;
+      }
+      if (i >= length) return false;
+      uint16_t off = (((t & 7) << 8) | in[i++]) + 1;
+      uint16_t len = ((t >> 3) & 15) + 3;
+      if (len == 18) {
+        if (i >= length) return false;
+        len += in[i++];
+      }
+      if (off > n || n + len > Unit) return false;
+      // Byte copy since the source may overlap the destination.
+      for (uint16_t k = 0; k < len; k++, n++) out[n] = out[n - off];
+    }
+    return n == Unit;
+  }
+  //----------------------------------------------------------------------------
+  static uint16_t hash(const uint8_t* p) {
+    uint16_t v = p[0] ^ (p[1] << 4) ^ (p[2] << 8);
+    return (uint16_t)(v*40503U) >> (16 - HASH_BITS);
+  }
+  //----------------------------------------------------------------------------
+  static bool literals(const uint8_t* src, uint16_t count, uint8_t* out,
+                       uint16_t* n) {
+    while (count) {
+      uint16_t k = count < 128 ? count : 128;
+      if (*n + k + 1 >= Unit) return false;
+      out[(*n)++] = k - 1;
+      memcpy(out + *n, src, k);
+      *n += k;
+      src += k;
+      count -= k;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  static uint16_t chainLength(uint16_t length) {
+    return (length + COMPRESSED_CHUNK_SIZE - 3)/(COMPRESSED_CHUNK_SIZE - 2);
+  }
+  uint32_t chunkAddress(uint16_t chunk) {
+    return rawStart() + rawBytes() + (uint32_t)chunk*COMPRESSED_CHUNK_SIZE;
+  }
+  static uint32_t mapAddress(uint32_t unit) {
+    return sizeof(CompressedHeader) + 4*unit;
+  }
+  uint32_t rawBytes() {return 512*m_header.rawBlocks;}
+  // Uncompressed blocks start at the first chunk boundary after the map.
+  uint32_t rawStart() {
+    uint32_t end = mapAddress(m_header.unitCount);
+    return (end + COMPRESSED_CHUNK_SIZE - 1) & ~(COMPRESSED_CHUNK_SIZE - 1UL);
+  }
+  // Bytes of a transfer before the end of the raw blocks or a unit.
+  size_t span(uint32_t address, size_t nbyte) {
+    uint32_t n = address < rawBytes() ? rawBytes() - address
+                 : Unit - (address - rawBytes()) % Unit;
+    return n < nbyte ? n : nbyte;
+  }
+  //----------------------------------------------------------------------------
+  // Return the chunks of a unit to the head of the free list.
+  bool freeChain(CompressedMapEntry entry) {
+    uint16_t count = chainLength(entry.length);
+    uint16_t tail = entry.chunk;
+    if (count == 0) return true;
+    for (uint16_t i = 1; i < count; i++) {
+      if (!m_dev->read(chunkAddress(tail), &tail, 2)) return false;
+      if (tail >= m_header.chunkCount) return false;
+    }
+    if (!m_dev->write(chunkAddress(tail), &m_header.freeHead, 2)) {
+      return false;
+    }
+    m_header.freeHead = entry.chunk;
+    m_header.freeCount += count;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  bool loadUnit(uint32_t unit) {
+    CompressedMapEntry entry;
+    if (!m_dev->read(mapAddress(unit), &entry, sizeof(entry))) return false;
+    if (entry.length == 0) {
+      memset(m_buf, 0, Unit);
+      return true;
+    }
+    if (entry.length > Unit) return false;
+    uint8_t* dst = entry.length == Unit ? m_buf : m_tmp;
+    uint16_t chunk = entry.chunk;
+    for (uint16_t i = 0; i < entry.length; i += COMPRESSED_CHUNK_SIZE - 2) {
+      uint16_t n = entry.length - i;
+      if (n > COMPRESSED_CHUNK_SIZE - 2) n = COMPRESSED_CHUNK_SIZE - 2;
+      if (chunk >= m_header.chunkCount) return false;
+      uint32_t address = chunkAddress(chunk);
+      if (!m_dev->read(address, &chunk, 2)) return false;
+      if (!m_dev->read(address + 2, dst + i, n)) return false;
+    }
+    return dst == m_buf || decompress(m_tmp, entry.length, m_buf);
+  }
+  //----------------------------------------------------------------------------
+  // Make unit the unit in Arduino SRAM.  Read it if load is true.
+  bool select(uint32_t unit, bool load) {
+    if (!m_dev || unit >= m_header.unitCount) return false;
+    if (unit == m_unit) return true;
+    if (!flush()) return false;
+    m_unit = NO_UNIT;
+    if (load && !loadUnit(unit)) return false;
+    m_unit = unit;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  // Take chunks from the free list and write src to them.
+  bool writeChain(CompressedMapEntry* entry, const uint8_t* src) {
+    uint16_t count = chainLength(entry->length);
+    uint16_t chunk = m_header.freeHead;
+    if (count == 0) return true;
+    if (count > m_header.freeCount) return false;
+    entry->chunk = chunk;
+    for (uint16_t i = 0; i < count; i++) {
+      uint16_t n = entry->length - i*(COMPRESSED_CHUNK_SIZE - 2);
+      uint16_t next = COMPRESSED_CHUNK_END;
+      uint32_t address = chunkAddress(chunk);
+      if (n > COMPRESSED_CHUNK_SIZE - 2) n = COMPRESSED_CHUNK_SIZE - 2;
+      if (!m_dev->read(address, &m_header.freeHead, 2)) return false;
+      // Keep the count right if a later write fails.
+      m_header.freeCount--;
+      if (i + 1 < count) next = m_header.freeHead;
+      if (!m_dev->write(address, &next, 2)) return false;
+      if (!m_dev->write(address + 2, src, n)) return false;
+      src += n;
+      chunk = next;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  RamBaseDevice* m_dev;       // backing device
+  CompressedHeader m_header;  // copy of backing device header
+  uint32_t m_unit;            // unit in m_buf or NO_UNIT
+  bool m_dirty;               // m_buf has changed
+  uint8_t m_buf[Unit];        // uncompressed unit
+  uint8_t m_tmp[Unit];        // compressed unit
+};
+#endif  // CompressedRamDevice_h
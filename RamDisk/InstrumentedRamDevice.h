@@ -0,0 +1,220 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef InstrumentedRamDevice_h
+#define InstrumentedRamDevice_h
+/**
+ * \file
+ * InstrumentedRamDevice class
+ */
+#include <RamVolume.h>
+//------------------------------------------------------------------------------
+/** Number of log2 buckets in a latency histogram. */
+const uint8_t RAM_IO_HIST_BUCKETS = 16;
+/** Histogram index for reads. */
+const uint8_t RAM_IO_READ = 0;
+/** Histogram index for writes and fills. */
+const uint8_t RAM_IO_WRITE = 1;
+//------------------------------------------------------------------------------
+/**
+ * \struct RamIoCounts
+ * \brief Device transactions and bytes for one I/O class.
+ */
+struct RamIoCounts {
+  /** Number of read calls. */
+  uint32_t reads;
+  /** Bytes read. */
+  uint32_t readBytes;
+  /** Number of write and fill calls. */
+  uint32_t writes;
+  /** Bytes written. */
+  uint32_t writeBytes;
+};
+//------------------------------------------------------------------------------
+/**
+ * \class InstrumentedRamDevice
+ * \brief Count and time the operations of another device.
+ *
+ * Each transaction is classified by the volume area at its start
+ * address, see RamVolume::ioClass().  Before attach() is called all
+ * transactions are counted as RAM_IO_DATA.
+ *
+ * Latency is measured with micros().  Bucket zero counts calls that take
+ * less than two microseconds and bucket i counts calls that take at least
+ * 2^i microseconds.  The last bucket also counts longer calls.
+ */
+class InstrumentedRamDevice : public RamBaseDevice {
+ public:
+  /** Create a device.  Calls fail until begin() is called. */
+  InstrumentedRamDevice() : m_dev(0), m_vol(0) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Select the volume used to classify transactions.
+   *
+   * \param[in] vol Volume initialized on this device or zero.
+   */
+  void attach(RamVolume* vol) {m_vol = vol;}
+  //----------------------------------------------------------------------------
+  /**
+   * Initialize the device with all counts zero.
+   *
+   * \param[in] dev Device to be measured.
+   */
+  void begin(RamBaseDevice* dev) {
+    m_dev = dev;
+    clearStats();
+  }
+  //----------------------------------------------------------------------------
+  /** Set all counts to zero. */
+  void clearStats() {
+    memset(m_counts, 0, sizeof(m_counts));
+    memset(m_hist, 0, sizeof(m_hist));
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * \param[in] ioClass RAM_IO_PARAMS, RAM_IO_FAT, RAM_IO_DIR or RAM_IO_DATA.
+   *
+   * \return Counts for \a ioClass.
+   */
+  const RamIoCounts* counts(uint8_t ioClass) {return &m_counts[ioClass];}
+  //----------------------------------------------------------------------------
+  /**
+   * \param[in] op RAM_IO_READ or RAM_IO_WRITE.
+   *
+   * \return Latency histogram with RAM_IO_HIST_BUCKETS entries for \a op.
+   */
+  const uint32_t* histogram(uint8_t op) {return m_hist[op];}
+  //----------------------------------------------------------------------------
+  /**
+   * Fill a region of the device.
+   *
+   * \param[in] address Start of the region.
+   *
+   * \param[in] value Value stored in each byte.
+   *
+   * \param[in] length Number of bytes in the region.
+   *
+   * \return true for success or false for failure.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    if (!m_dev) return false;
+    uint32_t m = micros();
+    bool rtn = m_dev->fill(address, value, length);
+    record(RAM_IO_WRITE, address, length, micros() - m);
+    return rtn;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Print counts by class and nonzero histogram buckets.
+   *
+   * \param[in] pr Print stream for the report.
+   */
+  void printStats(Print* pr) {
+    pr->println(F("class,reads,readBytes,writes,writeBytes"));
+    for (uint8_t i = 0; i < RAM_IO_CLASS_COUNT; i++) {
+      RamIoCounts* c = &m_counts[i];
+      pr->print(i == RAM_IO_PARAMS ? F("params") : i == RAM_IO_FAT ? F("FAT")
+                : i == RAM_IO_DIR ? F("dir") : F("data"));
+      pr->write(',');
+      pr->print(c->reads);
+      pr->write(',');
+      pr->print(c->readBytes);
+      pr->write(',');
+      pr->print(c->writes);
+      pr->write(',');
+      pr->println(c->writeBytes);
+    }
+    for (uint8_t op = 0; op < 2; op++) {
+      pr->print(op == RAM_IO_READ ? F("read") : F("write"));
+      pr->print(F(" micros"));
+      for (uint8_t i = 0; i < RAM_IO_HIST_BUCKETS; i++) {
+        if (!m_hist[op][i]) continue;
+        pr->print(F(" >="));
+        pr->print(i ? 1UL << i : 0UL);
+        pr->write(':');
+        pr->print(m_hist[op][i]);
+      }
+      pr->println();
+    }
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Read data from the device.
+   *
+   * \param[in] address Location to be read.
+   *
+   * \param[out] buf Pointer to the location that will receive the data.
+   *
+   * \param[in] nbyte Number of bytes to read.
+   *
+   * \return true for success or false for failure.
+   */
+  bool read(uint32_t address, void *buf, size_t nbyte) {
+    if (!m_dev) return false;
+    uint32_t m = micros();
+    bool rtn = m_dev->read(address, buf, nbyte);
+    record(RAM_IO_READ, address, nbyte, micros() - m);
+    return rtn;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of 512 byte blocks in the measured device. */
+  uint32_t sizeBlocks() {return m_dev ? m_dev->sizeBlocks() : 0;}
+  //----------------------------------------------------------------------------
+  /**
+   * Write data to the device.
+   *
+   * \param[in] address Location to be written.
+   *
+   * \param[in] buf Pointer to the location of the data to be written.
+   *
+   * \param[in] nbyte Number of bytes to write.
+   *
+   * \return true for success or false for failure.
+   */
+  bool write(uint32_t address, const void *buf, size_t nbyte) {
+    if (!m_dev) return false;
+    uint32_t m = micros();
+    bool rtn = m_dev->write(address, buf, nbyte);
+    record(RAM_IO_WRITE, address, nbyte, micros() - m);
+    return rtn;
+  }
+
+ private:
+  void record(uint8_t op, uint32_t address, uint32_t nbyte, uint32_t usec) {
+    RamIoCounts* c = &m_counts[m_vol ? m_vol->ioClass(address) : RAM_IO_DATA];
+    uint8_t i = 0;
+    if (op == RAM_IO_READ) {
+      c->reads++;
+      c->readBytes += nbyte;
+    } else {
+      c->writes++;
+      c->writeBytes += nbyte;
+    }
+    while (usec > 1 && i < RAM_IO_HIST_BUCKETS - 1) {
+      usec >>= 1;
+      i++;
+    }
+    m_hist[op][i]++;
+  }
+  RamBaseDevice* m_dev;                         // measured device
+  RamVolume* m_vol;                             // volume for ioClass()
+  RamIoCounts m_counts[RAM_IO_CLASS_COUNT];     // counts by class
+  uint32_t m_hist[2][RAM_IO_HIST_BUCKETS];      // latency by operation
+};
+#endif  // InstrumentedRamDevice_h
@@ -0,0 +1,213 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef MirrorRamDevice_h
+#define MirrorRamDevice_h
+/**
+ * \file
+ * MirrorRamDevice class
+ */
+#include <RamBaseDevice.h>
+//------------------------------------------------------------------------------
+/** setReadMember() value to alternate reads between members. */
+const uint8_t MIRROR_READ_ROUND_ROBIN = 0XFF;
+//------------------------------------------------------------------------------
+/**
+ * \class MirrorRamDevice
+ * \brief Keep identical copies of data on two devices.
+ *
+ * Writes go to both members.  Reads go to one member, either a fixed
+ * member or alternate members for devices on separate buses.  The size
+ * of the device is the size of the smaller member.
+ *
+ * If a member fails a write it is marked stale and the device continues
+ * with the other member.  A stale or replaced member is not read until
+ * resync() has copied the entire device to it.
+ */
+class MirrorRamDevice : public RamBaseDevice {
+ public:
+  /** Create a device.  Calls fail until begin() succeeds. */
+  MirrorRamDevice() : m_blocks(0) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Initialize the device with members that contain the same data.
+   *
+   * \param[in] dev0 First member.
+   *
+   * \param[in] dev1 Second member.
+   *
+   * \return true for success or false for failure.
+   */
+  bool begin(RamBaseDevice* dev0, RamBaseDevice* dev1) {
+    uint32_t n0 = dev0->sizeBlocks();
+    uint32_t n1 = dev1->sizeBlocks();
+    m_dev[0] = dev0;
+    m_dev[1] = dev1;
+    m_blocks = n0 < n1 ? n0 : n1;
+    m_stale = NONE;
+    m_readMember = MIRROR_READ_ROUND_ROBIN;
+    m_next = 0;
+    return m_blocks != 0;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Replace a member.  The new member is stale until resync() completes.
+   *
+   * \param[in] member Index of the member, zero or one.
+   *
+   * \param[in] dev The new device.
+   *
+   * \return true for success or false for failure.  replace() fails if
+   * the other member is stale or \a dev is too small.
+   */
+  bool replace(uint8_t member, RamBaseDevice* dev) {
+    if (member > 1 || (m_stale != NONE && m_stale != member)) return false;
+    if (dev->sizeBlocks() < m_blocks) return false;
+    m_dev[member] = dev;
+    setStale(member);
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Copy the next chunk of the device to the stale member.  Call from
+   * loop() until synced() returns true.  Writes during a resync go to
+   * both members so the resync does not need to restart.
+   *
+   * \param[in] buf Buffer for the copy.  Large buffers reduce the number
+   *            of calls and the bus overhead.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \return true for success or false for failure.
+   */
+  bool resync(uint8_t* buf, size_t size) {
+    if (m_stale == NONE) return true;
+    uint32_t left = (m_blocks << 9) - m_syncAddress;
+    size_t n = left < size ? left : size;
+    if (!m_dev[!m_stale]->read(m_syncAddress, buf, n)) return false;
+    if (!m_dev[m_stale]->write(m_syncAddress, buf, n)) return false;
+    m_syncAddress += n;
+    if (m_syncAddress == (m_blocks << 9)) m_stale = NONE;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Select the member used for reads.
+   *
+   * \param[in] member Index of the fastest member or
+   *            MIRROR_READ_ROUND_ROBIN to alternate members.
+   */
+  void setReadMember(uint8_t member) {m_readMember = member;}
+  //----------------------------------------------------------------------------
+  /** \return Index of the stale member or -1 if both members are synced. */
+  int8_t staleMember() {return m_stale == NONE ? -1 : m_stale;}
+  //----------------------------------------------------------------------------
+  /** \return true if both members have the same data. */
+  bool synced() {return m_stale == NONE;}
+  //----------------------------------------------------------------------------
+  /**
+   * Fill a region of the device.
+   *
+   * \param[in] address Start of the region.
+   *
+   * \param[in] value Value stored in each byte.
+   *
+   * \param[in] length Number of bytes in the region.
+   *
+   * \return true for success or false for failure.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    if (!check(address, length)) return false;
+    for (uint8_t i = 0; i < 2; i++) {
+      if (!m_dev[i]->fill(address, value, length) && !fail(i)) return false;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Read data from the device.  A failed read is retried on the other
+   * member if it is synced.
+   *
+   * \param[in] address Location to be read.
+   *
+   * \param[out] buf Pointer to the location that will receive the data.
+   *
+   * \param[in] nbyte Number of bytes to read.
+   *
+   * \return true for success or false for failure.
+   */
+  bool read(uint32_t address, void *buf, size_t nbyte) {
+    uint8_t i = m_readMember;
+    if (!check(address, nbyte)) return false;
+    if (i > 1) {
+      i = m_next;
+      m_next = !m_next;
+    }
+    if (i == m_stale) i = !i;
+    if (m_dev[i]->read(address, buf, nbyte)) return true;
+    return m_stale == NONE && m_dev[!i]->read(address, buf, nbyte);
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of 512 byte blocks in the smaller member. */
+  uint32_t sizeBlocks() {return m_blocks;}
+  //----------------------------------------------------------------------------
+  /**
+   * Write data to both members.
+   *
+   * \param[in] address Location to be written.
+   *
+   * \param[in] buf Pointer to the location of the data to be written.
+   *
+   * \param[in] nbyte Number of bytes to write.
+   *
+   * \return true for success or false for failure.
+   */
+  bool write(uint32_t address, const void *buf, size_t nbyte) {
+    if (!check(address, nbyte)) return false;
+    for (uint8_t i = 0; i < 2; i++) {
+      if (!m_dev[i]->write(address, buf, nbyte) && !fail(i)) return false;
+    }
+    return true;
+  }
+
+ private:
+  static const uint8_t NONE = 0XFF;
+  bool check(uint32_t address, uint32_t nbyte) {
+    return m_blocks && address + nbyte <= (m_blocks << 9)
+           && address + nbyte >= address;
+  }
+  // Mark member stale after an error.  Fail if no synced member is left.
+  bool fail(uint8_t member) {
+    if (m_stale != NONE && m_stale != member) return false;
+    setStale(member);
+    return true;
+  }
+  void setStale(uint8_t member) {
+    m_stale = member;
+    m_syncAddress = 0;
+  }
+
+  RamBaseDevice* m_dev[2];  // members
+  uint32_t m_blocks;        // size of smaller member
+  uint32_t m_syncAddress;   // resync position in stale member
+  uint8_t m_stale;          // member that needs resync or NONE
+  uint8_t m_readMember;     // member for reads or MIRROR_READ_ROUND_ROBIN
+  uint8_t m_next;           // next member for round robin reads
+};
+#endif  // MirrorRamDevice_h
@@ -26,12 +26,38 @@
 #define __need_size_t
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 //------------------------------------------------------------------------------
 /** \class RamBaseDevice
  * \brief RamBaseDevice virtual base class for derived RAM classes.
  */
 class RamBaseDevice {
  public:
+  /**
+   * Set a range of RAM to a value.
+   *
+   * The default implementation writes a small buffer in a loop.  Drivers
+   * override fill() to stream the value in a single SPI transfer.
+   *
+   * \param[in] address Location in RAM to be filled.
+   *
+   * \param[in] value Value for each byte.
+   *
+   * \param[in] length Number of bytes to fill.
+   *
+   * \return true for success or false for failure.
+   */
+  virtual bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    uint8_t buf[16];
+    memset(buf, value, sizeof(buf));
+    while (length) {
+      size_t n = length < sizeof(buf) ? length : sizeof(buf);
+      if (!write(address, buf, n)) return false;
+      address += n;
+      length -= n;
+    }
+    return true;
+  }
   /**
    * Read data from RAM.
    *
@@ -61,7 +61,7 @@ static bool make83Name(const char* str, uint8_t* name) {
 //------------------------------------------------------------------------------
 // add a cluster to a file
 bool RamBaseFile::addCluster() {
-  if (!m_vol->allocCluster(&m_curCluster)) {
+  if (!m_vol->allocCluster(&m_curCluster, m_windowSlot)) {
     DBG_FAIL_MACRO;
     goto fail;
   }
@@ -84,6 +84,9 @@ bool RamBaseFile::addCluster() {
  * Reasons for failure include no file is open or an I/O error.
  */
 bool RamBaseFile::close() {
+  RAM_TRACE_CALL((this, RAM_TRACE_CLOSE));
+  // Unused clusters in the window are available to other files.
+  if (isOpen()) m_vol->windowClose(m_windowSlot);
   bool rtn = sync();
   m_flags = 0;
   return rtn;
@@ -189,6 +192,7 @@ bool RamBaseFile::open(RamVolume* vol, const char* fileName, uint8_t oflag) {
   dir_t dir;
   uint8_t dname[11];   // name formated for dir entry
   int16_t empty = -1;  // index of empty slot
+  bool atEnd = false;  // empty slot is the end of directory marker
 
   if (!vol || isOpen()) return false;
   m_vol = vol;
@@ -202,7 +206,10 @@ bool RamBaseFile::open(RamVolume* vol, const char* fileName, uint8_t oflag) {
       // remember first empty slot
       if (empty < 0) empty = index;
       // done if no entries follow
-      if (dir.name[0] == DIR_NAME_FREE) break;
+      if (dir.name[0] == DIR_NAME_FREE) {
+        atEnd = empty == index;
+        break;
+      }
     } else if (!memcmp(dname, dir.name, 11)) {
       // don't open existing file if O_CREAT and O_EXCL
       if ((oflag & (O_CREAT | O_EXCL)) == (O_CREAT | O_EXCL)) return false;
@@ -219,6 +226,10 @@ bool RamBaseFile::open(RamVolume* vol, const char* fileName, uint8_t oflag) {
 
   // initialize as empty file
   memset(&dir, 0, sizeof(dir_t));
+  if (atEnd && (empty + 1) < m_vol->rootDirEntryCount()) {
+    // Move the end of directory marker.  Needed after a quick format.
+    if (!m_vol->writeDir(empty + 1, &dir)) return false;
+  }
   memcpy(dir.name, dname, 11);
   m_dirEntryIndex = empty;
 
@@ -274,6 +285,7 @@ bool RamBaseFile::open(RamVolume* vol, uint16_t index, uint8_t oflag) {
 }
 //------------------------------------------------------------------------------
 bool RamBaseFile::openDir(dir_t* dir, uint8_t oflag) {
+  RAM_TRACE_CALL((this, RAM_TRACE_OPEN, oflag, dir->name));
   if ((oflag & O_TRUNC) && !(oflag & O_WRITE)) {
     return false;
   }
@@ -291,8 +303,10 @@ bool RamBaseFile::openDir(dir_t* dir, uint8_t oflag) {
   m_curCluster = 0;
   m_curPosition = 0;
   m_fileSize = dir->fileSize;
-  m_firstCluster = dir->firstClusterLow;
+  m_firstCluster = m_vol->dirCluster(dir);
   m_flags = oflag & (O_ACCMODE | O_SYNC | O_APPEND);
+  // A file open for write allocates from a private window if one is free.
+  m_windowSlot = oflag & O_WRITE ? m_vol->windowOpen() : RamVolume::NO_WINDOW;
 
   if (oflag & O_TRUNC ) return truncate(0);
   if (oflag & O_AT_END) return seekEnd();
@@ -396,6 +410,7 @@ int16_t RamBaseFile::read() {
  * read mode, a corrupt file system, or an I/O error.
  */
 int RamBaseFile::read(void* buf, size_t nbyte) {
+  RAM_TRACE_CALL((this, RAM_TRACE_READ, nbyte));
   // convert void pointer to uin8_t pointer
   uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
 
@@ -445,6 +460,10 @@ int RamBaseFile::read(void* buf, size_t nbyte) {
 /**
  * Remove a file.  The directory entry and all data for the file are deleted.
  *
+ * The file's clusters are freed before return unless
+ * RAM_DISK_PENDING_FREE_SLOTS is nonzero and a slot is available.  Then
+ * they are freed by RamVolume::reclaim().
+ *
  * \note This function should not be used to delete the 8.3 version of a
  * file that has a long name. For example if a file has the long name
  * "New Text Document.txt" you should not delete the 8.3 name "NEWTEX~1.TXT".
@@ -455,16 +474,19 @@ int RamBaseFile::read(void* buf, size_t nbyte) {
  * or an I/O error occurred.
  */
 bool RamBaseFile::remove() {
+  RAM_TRACE_CALL((this, RAM_TRACE_REMOVE));
   // error if file is not open for write
   if (!(m_flags & O_WRITE)) return false;
   if (m_firstCluster) {
-    if (!m_vol->freeChain(m_firstCluster)) return false;
+    if (!m_vol->freeLater(m_firstCluster)) return false;
   }
   dir_t dir;
   if (!m_vol->readDir(m_dirEntryIndex, &dir)) return false;
   dir.name[0] = DIR_NAME_DELETED;
+  m_vol->windowClose(m_windowSlot);
   m_flags = 0;
-  return m_vol->writeDir(m_dirEntryIndex, &dir);
+  if (!m_vol->writeDir(m_dirEntryIndex, &dir)) return false;
+  return m_vol->syncParams();
 }
 //------------------------------------------------------------------------------
 /**
@@ -476,6 +498,7 @@ bool RamBaseFile::remove() {
  * the value zero, false, is returned for failure.
  */
 bool RamBaseFile::seekSet(uint32_t pos) {
+  RAM_TRACE_CALL((this, RAM_TRACE_SEEK, pos));
   // error if file not open or seek past end of file
   if (!isOpen() || pos > m_fileSize) return false;
   if (pos == 0) {
@@ -509,6 +532,7 @@ bool RamBaseFile::seekSet(uint32_t pos) {
  * opened or an I/O error.
  */
 bool RamBaseFile::sync() {
+  RAM_TRACE_CALL((this, RAM_TRACE_SYNC));
   if (m_flags & F_FILE_DIR_DIRTY) {
     dir_t dir;
     // cache directory entry
@@ -516,7 +540,7 @@ bool RamBaseFile::sync() {
 
     // update file size and first cluster
     dir.fileSize = m_fileSize;
-    dir.firstClusterLow = m_firstCluster;
+    m_vol->setDirCluster(&dir, m_firstCluster);
 
     // set modify time if user supplied a callback date/time function
     if (m_dateTime) {
@@ -524,9 +548,10 @@ bool RamBaseFile::sync() {
       dir.lastAccessDate = dir.lastWriteDate;
     }
     m_flags &= ~F_FILE_DIR_DIRTY;
-    return m_vol->writeDir(m_dirEntryIndex, &dir);
+    if (!m_vol->writeDir(m_dirEntryIndex, &dir)) return false;
   }
-  return true;
+  // Save the volume free count and allocation hint.
+  return isOpen() ? m_vol->syncParams() : true;
 }
 //------------------------------------------------------------------------------
 /**
@@ -599,6 +624,8 @@ bool RamBaseFile::timestamp(uint8_t flags, uint16_t year, uint8_t month,
  * will be maintained if it is less than or equal to \a length otherwise
  * it will be set to end of file.
  *
+ * Clusters past \a length are freed like those of remove().
+ *
  * \param[in] length The desired length for the file.
  *
  * \return The value one, true, is returned for success and
@@ -607,6 +634,7 @@ bool RamBaseFile::timestamp(uint8_t flags, uint16_t year, uint8_t month,
  * \a length is greater than the current file size or an I/O error occurs.
  */
 bool RamBaseFile::truncate(uint32_t length) {
+  RAM_TRACE_CALL((this, RAM_TRACE_TRUNCATE, length));
   // error if file is not open for write
   if (!(m_flags & O_WRITE)) return false;
 
@@ -617,7 +645,7 @@ bool RamBaseFile::truncate(uint32_t length) {
   uint32_t newPos = m_curPosition > length ? length : m_curPosition;
   if (length == 0) {
     // free all clusters
-    if (!m_vol->freeChain(m_firstCluster)) return false;
+    if (!m_vol->freeLater(m_firstCluster)) return false;
     m_curCluster = m_firstCluster = 0;
   } else {
     fat_t toFree;
@@ -625,8 +653,8 @@ bool RamBaseFile::truncate(uint32_t length) {
     if (!m_vol->fatGet(m_curCluster, &toFree)) return false;
     if (!isEOC(toFree)) {
       // free extra clusters
-      if (!m_vol->fatPut(m_curCluster, FAT16EOC)) return false;
-      if (!m_vol->freeChain(toFree)) return false;
+      if (!m_vol->fatPut(m_curCluster, RAM_DISK_EOC)) return false;
+      if (!m_vol->freeLater(toFree)) return false;
     }
   }
   m_fileSize = length;
@@ -652,6 +680,7 @@ bool RamBaseFile::truncate(uint32_t length) {
  *
  */
 int RamBaseFile::write(const void* buf, size_t nbyte) {
+  RAM_TRACE_CALL((this, RAM_TRACE_WRITE, nbyte));
   size_t nToWrite = nbyte;
   const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
 
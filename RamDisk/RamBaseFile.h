@@ -27,6 +27,7 @@
 #include <utility/FatStructs.h>
 #include <utility/FatApiConstants.h>
 #include <RamVolume.h>
+#include <RamTrace.h>
 //------------------------------------------------------------------------------
 /** \class RamBaseFile
  * \brief RamBaseFile implements a minimal Arduino RamDisk Library
@@ -165,7 +166,10 @@ class RamBaseFile {
   bool remove();
 
   /** Sets the file's current position to zero. */
-  void rewind() {m_curPosition = m_curCluster = 0;}
+  void rewind() {
+    RAM_TRACE_CALL((this, RAM_TRACE_SEEK, 0));
+    m_curPosition = m_curCluster = 0;
+  }
   /**
    * Seek to current position plus \a pos bytes. See RamDisk::seekSet().
    *
@@ -184,6 +188,8 @@ class RamBaseFile {
   bool timestamp(uint8_t flag, uint16_t year, uint8_t month, uint8_t day,
           uint8_t hour, uint8_t minute, uint8_t second);
   bool truncate(uint32_t size);
+  /** \return RamVolume that contains this file. */
+  RamVolume* volume() const {return m_vol;}
   /** RamDisk::writeError is set to true if an error occurs during a write().
    * Set RamDisk::writeError to false before calling print() and/or write()
    * and check for true after calls to write() and/or print().
@@ -210,10 +216,11 @@ class RamBaseFile {
   int16_t m_dirEntryIndex;  // index of directory entry for open file
   fat_t m_curCluster;       // current cluster
   fat_t m_firstCluster;     // first cluster of file
+  uint8_t m_windowSlot;     // allocation window of volume
   RamVolume* m_vol;         // volume for this file
 
   // end of chain test
-  bool isEOC(fat_t cluster) {return cluster >= 0XFFF8;}
+  bool isEOC(fat_t cluster) {return cluster >= RAM_DISK_EOC_MIN;}
   // allocate a cluster to a file
   bool addCluster();
   bool openDir(dir_t* dir, uint8_t oflag);
@@ -0,0 +1,123 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef RamCheckpoint_h
+#define RamCheckpoint_h
+/**
+ * \file
+ * RamCheckpoint class
+ *
+ * This file requires the SdFat library.  It is not included by RamDisk.h.
+ */
+#include <SdFat.h>
+#include <RamVolume.h>
+//------------------------------------------------------------------------------
+/**
+ * \class RamCheckpoint
+ * \brief Save a RamVolume to an SD image file and restore it.
+ *
+ * The image is a byte for byte copy of the volume's area of the RAM
+ * device.  The first save() writes the entire volume.  Later saves write
+ * only regions marked in the volume's dirty map, see
+ * RamVolume::setDirtyMap(), so the cost of a checkpoint depends on the
+ * amount of data changed rather than the size of the volume.
+ *
+ * Open RAM files should be synced before save() so directory entries
+ * are current.
+ */
+class RamCheckpoint {
+ public:
+  //----------------------------------------------------------------------------
+  /**
+   * Restore a volume from an image file then initialize the volume.
+   *
+   * Dirty tracking, if enabled, is reset with all regions clean.
+   *
+   * \param[in] vol Volume to be restored.
+   *
+   * \param[in] dev RAM device for the volume.
+   *
+   * \param[in] image SD image file open for read.
+   *
+   * \param[in] buf Buffer for the copy.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \return true for success or false for failure.
+   */
+  static bool restore(RamVolume* vol, RamBaseDevice* dev, SdBaseFile* image,
+                      uint8_t* buf, size_t size) {
+    uint32_t left = image->fileSize();
+    uint32_t address = 0;
+    if (left == 0 || !image->seekSet(0)) return false;
+    while (left) {
+      size_t n = left < size ? left : size;
+      if (image->read(buf, n) != (int)n) return false;
+      if (!dev->write(address, buf, n)) return false;
+      address += n;
+      left -= n;
+    }
+    if (!vol->init(dev)) return false;
+    if (vol->dirtyMap()) vol->setDirtyMap(vol->dirtyMap(), false);
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Save a volume to an image file.
+   *
+   * If the image is smaller than the volume all regions are written,
+   * otherwise only dirty regions are written.  A region is marked clean
+   * after it has been written.  The image is synced before return.
+   *
+   * \param[in] vol Volume with dirty tracking enabled.
+   *
+   * \param[in] image SD image file open for read and write.
+   *
+   * \param[in] buf Buffer for the copy.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \return true for success or false for failure.
+   */
+  static bool save(RamVolume* vol, SdBaseFile* image, uint8_t* buf,
+                   size_t size) {
+    RamBaseDevice* dev = vol->device();
+    uint32_t count = vol->dirtyRegionCount();
+    uint32_t volSize = vol->dirtyRegionAddress(count - 1)
+                       + vol->dirtyRegionSize(count - 1);
+    bool all = image->fileSize() < volSize;
+    if (!vol->dirtyMap() || size == 0) return false;
+    for (uint32_t i = 0; i < count; i++) {
+      if (!all && !vol->dirtyRegion(i)) continue;
+      uint32_t address = vol->dirtyRegionAddress(i);
+      uint16_t left = vol->dirtyRegionSize(i);
+      if (!image->seekSet(address)) return false;
+      while (left) {
+        size_t n = left < size ? left : size;
+        if (!dev->read(address, buf, n)) return false;
+        if (image->write(buf, n) != (int)n) return false;
+        address += n;
+        left -= n;
+      }
+      vol->dirtyClear(i);
+    }
+    return image->sync();
+  }
+};
+#endif  // RamCheckpoint_h
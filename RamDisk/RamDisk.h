@@ -28,6 +28,7 @@
 #include <RamBaseFile.h>
 #include <RamFile.h>
 #include <RamStream.h>
+#include <RamLogQueue.h>
 //------------------------------------------------------------------------------
 /** RamDisk version YYYYMMDD */
 #define RAM_DISK_VERSION 20140429
@@ -0,0 +1,88 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+/**
+ * \file
+ * \brief RamDisk configuration definitions
+ */
+#ifndef RamDiskConfig_h
+#define RamDiskConfig_h
+//------------------------------------------------------------------------------
+/**
+ * Set RAM_DISK_USE_32_BIT_FAT nonzero to use 32-bit FAT entries.
+ *
+ * 16-bit entries limit a volume to about 65000 clusters and the FAT to
+ * 255 blocks.  32-bit entries remove these limits so large devices can
+ * use small clusters.  Each FAT entry takes twice the space.
+ *
+ * Volumes formatted with one setting can't be mounted with the other
+ * except for volumes with a FAT boot sector.
+ */
+#ifndef RAM_DISK_USE_32_BIT_FAT
+#define RAM_DISK_USE_32_BIT_FAT 0
+#endif  // RAM_DISK_USE_32_BIT_FAT
+//------------------------------------------------------------------------------
+/**
+ * Number of files open for write that can have an allocation window.
+ *
+ * A file with a window allocates clusters from a private region of
+ * RAM_DISK_RESERVE_CLUSTERS clusters so files written at the same time
+ * stay contiguous.  Windows are not recorded in the FAT.  Each slot uses
+ * two FAT entries of Arduino SRAM.
+ *
+ * Set RAM_DISK_RESERVE_SLOTS zero to disable allocation windows.
+ */
+#ifndef RAM_DISK_RESERVE_SLOTS
+#define RAM_DISK_RESERVE_SLOTS 6
+#endif  // RAM_DISK_RESERVE_SLOTS
+/**
+ * Size of an allocation window in clusters.
+ */
+#ifndef RAM_DISK_RESERVE_CLUSTERS
+#define RAM_DISK_RESERVE_CLUSTERS 16
+#endif  // RAM_DISK_RESERVE_CLUSTERS
+//------------------------------------------------------------------------------
+/**
+ * Number of removed cluster chains that can wait to be freed.
+ *
+ * RamBaseFile::remove() and RamBaseFile::truncate() detach a chain in
+ * constant time and RamVolume::reclaim() frees it later.  If all slots
+ * are in use the chain is freed immediately.  Each slot uses one FAT
+ * entry of Arduino SRAM.
+ *
+ * Pending chains are kept only in SRAM.  The sketch must call reclaim()
+ * before a reset or the clusters stay allocated until check() repairs
+ * the volume.  Pending clusters are not counted by freeClusterCount().
+ *
+ * Zero, the default, always frees chains immediately.
+ */
+#ifndef RAM_DISK_PENDING_FREE_SLOTS
+#define RAM_DISK_PENDING_FREE_SLOTS 0
+#endif  // RAM_DISK_PENDING_FREE_SLOTS
+//------------------------------------------------------------------------------
+/**
+ * Set RAM_DISK_TRACE nonzero to record RamBaseFile calls with RamTrace.
+ *
+ * Each traced call checks for an active trace, which adds a few
+ * microseconds to each read(), write() and seek.
+ */
+#ifndef RAM_DISK_TRACE
+#define RAM_DISK_TRACE 0
+#endif  // RAM_DISK_TRACE
+#endif  // RamDiskConfig_h
@@ -0,0 +1,164 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef RamLogQueue_h
+#define RamLogQueue_h
+/**
+ * \file
+ * RamLogQueue class
+ */
+#include <Arduino.h>
+#include <RamBaseFile.h>
+//------------------------------------------------------------------------------
+/** Compiler barrier so record data is stored before an index is published. */
+#define RAM_LOG_QUEUE_BARRIER() __asm__ __volatile__("" ::: "memory")
+//------------------------------------------------------------------------------
+/**
+ * \class RamLogQueue
+ * \brief Single-producer/single-consumer ring of fixed size records.
+ *
+ * An interrupt routine fills record slots with reserve()/commit() or
+ * push().  The main program calls drain() to write queued records to
+ * a RamBaseFile.  No locks are used, the producer only stores m_head and
+ * the consumer only stores m_tail.  Indices are eight bits so loads and
+ * stores are atomic on AVR.
+ *
+ * The queue holds at most SlotCount - 1 records.
+ *
+ * \tparam RecordSize Size of a record in bytes.
+ * \tparam SlotCount Number of record slots, 2 to 255.
+ */
+template<size_t RecordSize, uint8_t SlotCount>
+class RamLogQueue {
+ public:
+  /** Create an empty queue. */
+  RamLogQueue() : m_head(0), m_tail(0), m_highWater(0), m_overrunCount(0) {}
+  //----------------------------------------------------------------------------
+  /** \return Number of records in the queue. Call from either side. */
+  uint8_t available() {
+    uint8_t head = m_head;
+    uint8_t tail = m_tail;
+    return head >= tail ? head - tail : SlotCount - tail + head;
+  }
+  //----------------------------------------------------------------------------
+  /** Publish the record returned by reserve().  Producer only. */
+  void commit() {
+    uint8_t head = next(m_head);
+    RAM_LOG_QUEUE_BARRIER();
+    m_head = head;
+    uint8_t n = available();
+    if (n > m_highWater) m_highWater = n;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Write queued records to a file.  Consumer only.
+   *
+   * Records that are contiguous in the ring are written with a single
+   * call to RamBaseFile::write().  If a write would cross a cluster
+   * boundary of the file it is trimmed to end on the boundary so the
+   * next write starts a new cluster.
+   *
+   * \param[in] file Open file positioned at the point to be written.
+   *
+   * \param[in] budgetMicros No new write is started after this many
+   *            micros have elapsed.  At least one write is done if records
+   *            are available.
+   *
+   * \return The number of records written or -1 if a write error occurs.
+   */
+  int drain(RamBaseFile* file, uint32_t budgetMicros) {
+    uint32_t m = micros();
+    uint16_t mask = file->volume()->clusterSizeBytes() - 1;
+    int rtn = 0;
+    do {
+      uint8_t head = m_head;
+      uint8_t tail = m_tail;
+      if (head == tail) break;
+      // Records before the wrap point are contiguous.
+      uint8_t n = head > tail ? head - tail : SlotCount - tail;
+      uint32_t pos = file->curPosition();
+      uint32_t end = pos + (uint32_t)n*RecordSize;
+      uint32_t boundary = end & ~(uint32_t)mask;
+      if (boundary > pos && boundary < end
+        && (boundary - pos) >= RecordSize) {
+        n = (boundary - pos)/RecordSize;
+      }
+      size_t nb = (size_t)n*RecordSize;
+      if (file->write(m_buf[tail], nb) != (int)nb) return -1;
+      tail += n;
+      if (tail == SlotCount) tail = 0;
+      RAM_LOG_QUEUE_BARRIER();
+      m_tail = tail;
+      rtn += n;
+    } while ((micros() - m) < budgetMicros);
+    return rtn;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Maximum number of records that have been in the queue. */
+  uint8_t highWater() {return m_highWater;}
+  //----------------------------------------------------------------------------
+  /** \return Number of records dropped because the queue was full. */
+  uint16_t overrunCount() {
+    // Read until stable since a 16-bit load is not atomic on AVR.
+    uint16_t n;
+    do {
+      n = m_overrunCount;
+    } while (n != m_overrunCount);
+    return n;
+  }
+  //----------------------------------------------------------------------------
+  /** Copy a record into the queue.  Producer only.
+   *
+   * \param[in] rec Location of RecordSize bytes to be queued.
+   *
+   * \return true for success or false if the queue is full.
+   */
+  bool push(const void* rec) {
+    void* p = reserve();
+    if (!p) return false;
+    memcpy(p, rec, RecordSize);
+    commit();
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** Get the next free record slot.  Producer only.
+   *
+   * Fill the slot then call commit().
+   *
+   * \return Pointer to RecordSize bytes or zero if the queue is full.
+   */
+  void* reserve() {
+    uint8_t head = m_head;
+    if (next(head) == m_tail) {
+      m_overrunCount++;
+      return 0;
+    }
+    return m_buf[head];
+  }
+
+ private:
+  uint8_t next(uint8_t i) {return ++i < SlotCount ? i : 0;}
+
+  uint8_t m_buf[SlotCount][RecordSize];
+  volatile uint8_t m_head;            // next slot to fill
+  volatile uint8_t m_tail;            // next slot to write to file
+  volatile uint8_t m_highWater;       // maximum records queued
+  volatile uint16_t m_overrunCount;   // records dropped
+};
+#endif  // RamLogQueue_h
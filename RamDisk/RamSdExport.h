@@ -0,0 +1,208 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef RamSdExport_h
+#define RamSdExport_h
+/**
+ * \file
+ * RamSdExport class
+ *
+ * This file requires the SdFat library.  It is not included by RamDisk.h.
+ */
+#include <SdFat.h>
+#include <RamBaseFile.h>
+//------------------------------------------------------------------------------
+/**
+ * \class RamSdExport
+ * \brief Incremental copy of a RamBaseFile to an SdBaseFile.
+ *
+ * The caller's buffer is split into two halves.  Each call to poll()
+ * does at most one step, either a read of one chunk from the RAM file
+ * into a free half or a write of one full half to the SD file.  The SD
+ * write is skipped while the card is busy so poll() returns quickly and
+ * the time is used to read ahead from RAM.
+ *
+ * A chunk is the RAM volume's cluster size limited by half the buffer.
+ *
+ * copyContiguous() is a blocking alternative that streams a file to a
+ * contiguous SD file with one multiple block write.
+ */
+class RamSdExport {
+ public:
+  /** poll() return value - more steps are required. */
+  static const int8_t EXPORT_BUSY = 1;
+  /** poll() return value - copy is complete and the SD file is synced. */
+  static const int8_t EXPORT_DONE = 0;
+  /** poll() return value - an I/O error occurred. */
+  static const int8_t EXPORT_ERROR = -1;
+
+  /** Create an export engine.  poll() fails until begin() succeeds. */
+  RamSdExport() : m_state(EXPORT_ERROR) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Start or resume a copy.
+   *
+   * \param[in] src RAM file open for read.
+   *
+   * \param[in] dst SD file open for write.  If \a position is not zero
+   *            \a dst must contain at least \a position bytes.
+   *
+   * \param[in] buf Buffer for the copy.  Must be at least two bytes.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \param[in] position Offset to start the copy.  Use the value of
+   *            position() saved from an earlier copy to resume.
+   *
+   * \return true for success or false for failure.
+   */
+  bool begin(RamBaseFile* src, SdBaseFile* dst, uint8_t* buf, size_t size,
+             uint32_t position = 0) {
+    m_state = EXPORT_ERROR;
+    m_chunkSize = size/2;
+    if (m_chunkSize > src->volume()->clusterSizeBytes()) {
+      m_chunkSize = src->volume()->clusterSizeBytes();
+    }
+    if (m_chunkSize == 0 || position > src->fileSize()) return false;
+    if (!src->seekSet(position) || !dst->seekSet(position)) return false;
+    m_src = src;
+    m_dst = dst;
+    m_buf = buf;
+    m_size = src->fileSize();
+    m_position = position;
+    m_count[0] = m_count[1] = 0;
+    m_rd = m_wr = 0;
+    m_state = EXPORT_BUSY;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Copy a RAM file to a new contiguous SD file with one multiple block
+   * write.
+   *
+   * The SD file is preallocated with SdBaseFile::createContiguous().
+   * Data is read from the RAM file 512 bytes at a time into the SdVolume
+   * cache buffer and sent with Sd2Card::writeData() in a single CMD25
+   * sequence so no SD cache or FAT operations occur during the transfer.
+   * The last block is zero filled.  An empty RAM file creates an empty SD
+   * file since a contiguous file must have at least one cluster.
+   *
+   * This call blocks until the copy is complete.
+   *
+   * \param[in] src RAM file open for read.  The copy starts at the
+   *            beginning of the file.
+   *
+   * \param[in] dirFile SD directory for the new file.
+   *
+   * \param[in] path Name of the new file.  The file must not exist.
+   *
+   * \param[out] dst SD file that will be created.  \a dst must be closed.
+   *
+   * \return true for success or false for failure.
+   */
+  static bool copyContiguous(RamBaseFile* src, SdBaseFile* dirFile,
+                             const char* path, SdBaseFile* dst) {
+    uint32_t bgnBlock, endBlock;
+    uint32_t left = src->fileSize();
+    Sd2Card* card;
+    cache_t* pc;
+    uint8_t* cache;
+    if (!src->seekSet(0)) return false;
+    if (left == 0) {
+      return dst->open(dirFile, path, O_CREAT | O_EXCL | O_RDWR)
+             && dst->sync();
+    }
+    if (!dst->createContiguous(dirFile, path, left)) return false;
+    if (!dst->contiguousRange(&bgnBlock, &endBlock)) return false;
+    // dst has a volume only after it is open.
+    card = dst->volume()->sdCard();
+    // Flush and invalidate the SD cache then use it as the buffer.
+    pc = dst->volume()->cacheClear();
+    if (!pc) return false;
+    cache = pc->data;
+    if (!card->writeStart(bgnBlock, ((left + 511) >> 9))) return false;
+    while (left) {
+      uint16_t n = left < 512 ? left : 512;
+      if (src->read(cache, n) != (int)n) goto fail;
+      if (n < 512) memset(cache + n, 0, 512 - n);
+      if (!card->writeData(cache)) goto fail;
+      left -= n;
+    }
+    return card->writeStop();
+
+   fail:
+    card->writeStop();
+    return false;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of bytes that have been written to the SD file. */
+  uint32_t position() {return m_position;}
+  //----------------------------------------------------------------------------
+  /**
+   * Do one bounded step of the copy.
+   *
+   * \return EXPORT_BUSY if more steps are required, EXPORT_DONE if the
+   *         copy is complete or EXPORT_ERROR if an I/O error occurred.
+   */
+  int8_t poll() {
+    if (m_state != EXPORT_BUSY) return m_state;
+    if (m_count[m_wr] && !m_dst->volume()->sdCard()->isBusy()) {
+      // Write a full half to the SD.
+      uint16_t n = m_count[m_wr];
+      if (m_dst->write(half(m_wr), n) != (int)n) goto fail;
+      m_position += n;
+      m_count[m_wr] = 0;
+      m_wr ^= 1;
+    } else if (m_count[m_rd] == 0
+               && (m_position + m_count[0] + m_count[1]) < m_size) {
+      // Read ahead into a free half.
+      uint32_t left = m_size - m_position - m_count[0] - m_count[1];
+      uint16_t n = left < m_chunkSize ? left : m_chunkSize;
+      if (m_src->read(half(m_rd), n) != (int)n) goto fail;
+      m_count[m_rd] = n;
+      m_rd ^= 1;
+    } else if (m_position == m_size) {
+      if (!m_dst->sync()) goto fail;
+      m_state = EXPORT_DONE;
+    }
+    return m_state;
+
+   fail:
+    m_state = EXPORT_ERROR;
+    return m_state;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Total number of bytes to be copied. */
+  uint32_t size() {return m_size;}
+
+ private:
+  uint8_t* half(uint8_t i) {return m_buf + (i ? m_chunkSize : 0);}
+
+  RamBaseFile* m_src;    // source file
+  SdBaseFile* m_dst;     // destination file
+  uint8_t* m_buf;        // caller's buffer
+  uint32_t m_size;       // bytes to copy
+  uint32_t m_position;   // bytes written to SD
+  uint16_t m_chunkSize;  // size of one half of m_buf
+  uint16_t m_count[2];   // bytes in each half
+  uint8_t m_rd;          // next half to fill from RAM
+  uint8_t m_wr;          // next half to write to SD
+  int8_t m_state;        // EXPORT_BUSY, EXPORT_DONE or EXPORT_ERROR
+};
+#endif  // RamSdExport_h
@@ -0,0 +1,206 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef RamSdStager_h
+#define RamSdStager_h
+/**
+ * \file
+ * RamSdStager class
+ *
+ * This file requires the SdFat library.  It is not included by RamDisk.h.
+ */
+#include <SdFat.h>
+#include <RamBaseDevice.h>
+//------------------------------------------------------------------------------
+/**
+ * \class RamSdStager
+ * \brief Stage log data in external RAM and drain it to a contiguous SD file.
+ *
+ * Data is written to a ring of 512 byte blocks on a RamBaseDevice.
+ * poll() sends one complete block to the SD with Sd2Card::writeData()
+ * each time it is called and the card is not busy.  All blocks are sent
+ * in a single multiple block write so the SD file must be contiguous,
+ * see SdBaseFile::createContiguous().
+ *
+ * The SdVolume cache buffer is used to move blocks from RAM to the SD so
+ * no Arduino SRAM is used for block buffers.  Other SdFat calls must not
+ * be made between begin() and finish().
+ *
+ * write() and poll() both use SPI so they must be called from the same
+ * context, not from an interrupt routine.
+ */
+class RamSdStager {
+ public:
+  /** Create a stager.  write() and poll() fail until begin() succeeds. */
+  RamSdStager() : m_dev(0) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Start a multiple block write to a contiguous SD file.
+   *
+   * \param[in] dev RAM device for staged blocks.
+   *
+   * \param[in] address Start of a region on \a dev with room for
+   *            \a ringBlocks 512 byte blocks.
+   *
+   * \param[in] ringBlocks Number of blocks in the ring.
+   *
+   * \param[in] file Open contiguous SD file.  Data is written starting at
+   *            the first block of the file.
+   *
+   * \return true for success or false for failure.
+   */
+  bool begin(RamBaseDevice* dev, uint32_t address, uint16_t ringBlocks,
+             SdBaseFile* file) {
+    uint32_t bgnBlock, endBlock;
+    cache_t* pc;
+    m_dev = 0;
+    if (ringBlocks == 0) return false;
+    if (!file->contiguousRange(&bgnBlock, &endBlock)) return false;
+    // Flush and invalidate the SD cache then use it as the buffer.
+    pc = file->volume()->cacheClear();
+    if (!pc) return false;
+    m_card = file->volume()->sdCard();
+    if (!m_card->writeStart(bgnBlock, endBlock - bgnBlock + 1)) return false;
+    m_buf = pc->data;
+    m_fileBlocks = endBlock - bgnBlock + 1;
+    m_address = address;
+    m_ringBlocks = ringBlocks;
+    m_head = m_tail = m_depth = m_peakDepth = m_offset = 0;
+    m_blocksWritten = 0;
+    m_overrunCount = 0;
+    m_dev = dev;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of blocks that have been written to the SD. */
+  uint32_t blocksWritten() {return m_blocksWritten;}
+  //----------------------------------------------------------------------------
+  /** \return Number of complete blocks waiting in the ring. */
+  uint16_t depth() {return m_depth;}
+  //----------------------------------------------------------------------------
+  /**
+   * Zero fill a partial block, send all staged blocks to the SD and end
+   * the multiple block write.  This call blocks until the SD is idle.
+   *
+   * \return true for success or false for failure.
+   */
+  bool finish() {
+    if (!m_dev) return false;
+    if (m_offset) {
+      // Space for the rest of the block was reserved by write().
+      memset(m_buf, 0, 512 - m_offset);
+      if (!m_dev->write(blockAddress(m_head) + m_offset,
+                        m_buf, 512 - m_offset)) {
+        goto fail;
+      }
+      commitBlock();
+    }
+    while (m_depth) {
+      if (!sendBlock()) goto fail;
+    }
+    m_dev = 0;
+    return m_card->writeStop();
+
+   fail:
+    m_dev = 0;
+    return false;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of write() calls that were dropped for lack of space. */
+  uint32_t overrunCount() {return m_overrunCount;}
+  //----------------------------------------------------------------------------
+  /** \return Maximum number of complete blocks that have been in the ring. */
+  uint16_t peakDepth() {return m_peakDepth;}
+  //----------------------------------------------------------------------------
+  /**
+   * Send one staged block to the SD if the card is not busy.
+   *
+   * \return true for success or false if an I/O error occurred.
+   */
+  bool poll() {
+    if (!m_dev) return false;
+    if (m_depth == 0 || m_card->isBusy()) return true;
+    return sendBlock();
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Stage data.  Data is never split by an overrun, either all of \a src
+   * is staged or none of it.
+   *
+   * \param[in] src Data to be staged.
+   *
+   * \param[in] n Number of bytes in \a src.
+   *
+   * \return true for success or false if there is not enough space in the
+   *         ring or the SD file, or an I/O error occurred.
+   */
+  bool write(const void* src, size_t n) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(src);
+    if (!m_dev) return false;
+    // Space in the ring limited by space in the file.
+    uint32_t free = m_ringBlocks - m_depth;
+    uint32_t fileFree = m_fileBlocks - m_blocksWritten - m_depth;
+    if (fileFree < free) free = fileFree;
+    if (n > 512*free - m_offset) {
+      m_overrunCount++;
+      return false;
+    }
+    while (n) {
+      size_t k = 512 - m_offset;
+      if (k > n) k = n;
+      if (!m_dev->write(blockAddress(m_head) + m_offset, p, k)) return false;
+      p += k;
+      n -= k;
+      m_offset += k;
+      if (m_offset == 512) commitBlock();
+    }
+    return true;
+  }
+
+ private:
+  uint32_t blockAddress(uint16_t i) {return m_address + 512UL*i;}
+  void commitBlock() {
+    m_offset = 0;
+    if (++m_head == m_ringBlocks) m_head = 0;
+    if (++m_depth > m_peakDepth) m_peakDepth = m_depth;
+  }
+  bool sendBlock() {
+    if (!m_dev->read(blockAddress(m_tail), m_buf, 512)) return false;
+    if (!m_card->writeData(m_buf)) return false;
+    if (++m_tail == m_ringBlocks) m_tail = 0;
+    m_depth--;
+    m_blocksWritten++;
+    return true;
+  }
+
+  RamBaseDevice* m_dev;     // RAM device for the ring
+  Sd2Card* m_card;          // card for the multiple block write
+  uint8_t* m_buf;           // SdVolume cache buffer
+  uint32_t m_address;       // address of the ring on m_dev
+  uint32_t m_fileBlocks;    // size of the SD file in blocks
+  uint32_t m_blocksWritten; // blocks sent to the SD
+  uint32_t m_overrunCount;  // dropped write() calls
+  uint16_t m_ringBlocks;    // size of the ring in blocks
+  uint16_t m_head;          // block being filled
+  uint16_t m_tail;          // next block to send
+  uint16_t m_depth;         // complete blocks in the ring
+  uint16_t m_peakDepth;     // maximum of m_depth
+  uint16_t m_offset;        // bytes in the head block
+};
+#endif  // RamSdStager_h
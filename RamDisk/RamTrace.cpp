@@ -0,0 +1,145 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#include <RamTrace.h>
+//------------------------------------------------------------------------------
+uint8_t RamTrace::m_depth = 0;
+RamTrace* RamTrace::m_current = 0;
+//------------------------------------------------------------------------------
+/**
+ * Start recording.  Only one trace can be active.
+ *
+ * \param[in] dev Device for the trace region.  The region must not be
+ * used by a volume.
+ *
+ * \param[in] address Start of the trace region.
+ *
+ * \param[in] size Size of the trace region in bytes.
+ *
+ * \return true for success or false for failure.
+ */
+bool RamTrace::begin(RamBaseDevice* dev, uint32_t address, uint32_t size) {
+  if (m_current || size <= RAM_TRACE_HEADER_SIZE) return false;
+  m_dev = dev;
+  m_address = address;
+  m_size = size;
+  m_length = 0;
+  m_count = 0;
+  m_overflow = false;
+  for (uint8_t i = 0; i < RAM_TRACE_FILES; i++) m_file[i] = 0;
+  m_current = this;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Stop recording and write the trace header.
+ *
+ * \return true for success or false for failure.
+ */
+bool RamTrace::end() {
+  uint32_t header[2];
+  if (m_current != this) return false;
+  m_current = 0;
+  if (!flushBuf()) return false;
+  header[0] = RAM_TRACE_MAGIC;
+  header[1] = m_length;
+  return m_dev->write(m_address, header, sizeof(header));
+}
+//------------------------------------------------------------------------------
+bool RamTrace::flushBuf() {
+  if (m_count == 0) return true;
+  uint32_t address = m_address + RAM_TRACE_HEADER_SIZE + m_length;
+  if (!m_dev->write(address, m_buf, m_count)) return false;
+  m_length += m_count;
+  m_count = 0;
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Print the trace region, header and records, as hex with 32 bytes per
+ * line.  Call after end().
+ *
+ * \param[in] pr Print stream for the output.
+ *
+ * \return true for success or false for failure.
+ */
+bool RamTrace::printHex(Print* pr) {
+  uint8_t buf[16];
+  uint32_t n = RAM_TRACE_HEADER_SIZE + m_length;
+  if (!m_dev || m_current == this) return false;
+  for (uint32_t i = 0; i < n; i += sizeof(buf)) {
+    uint8_t k = n - i < sizeof(buf) ? n - i : sizeof(buf);
+    if (!m_dev->read(m_address + i, buf, k)) return false;
+    for (uint8_t j = 0; j < k; j++) {
+      if (buf[j] < 16) pr->write('0');
+      pr->print(buf[j], HEX);
+      if ((i + j) % 32 == 31) pr->println();
+    }
+  }
+  if (n % 32) pr->println();
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+ * Add a record.  Called by RamTraceCall.
+ *
+ * \param[in] file The RamBaseFile called.
+ * \param[in] type Record type.
+ * \param[in] arg Count, position, length or oflag.
+ * \param[in] name Directory name for RAM_TRACE_OPEN.
+ */
+void RamTrace::record(const void* file, uint8_t type, uint32_t arg,
+                      const uint8_t* name) {
+  uint8_t rec[13];
+  uint8_t n = 1;
+  uint8_t id;
+  if (m_overflow) return;
+  // An open keeps the number of a file whose last open failed.
+  for (id = 0; id < RAM_TRACE_FILES && m_file[id] != file; id++) {}
+  if (id == RAM_TRACE_FILES && type == RAM_TRACE_OPEN) {
+    for (id = 0; id < RAM_TRACE_FILES && m_file[id]; id++) {}
+  }
+  // No free file number or the file was opened before begin().
+  if (id == RAM_TRACE_FILES) return;
+  rec[0] = type << 3 | id;
+  if (type == RAM_TRACE_OPEN) {
+    m_file[id] = file;
+    rec[n++] = arg;
+    memcpy(rec + n, name, 11);
+    n += 11;
+  } else if (type == RAM_TRACE_CLOSE || type == RAM_TRACE_REMOVE) {
+    m_file[id] = 0;
+  } else if (type != RAM_TRACE_SYNC) {
+    do {
+      rec[n++] = (arg & 0X7F) | (arg > 0X7F ? 0X80 : 0);
+      arg >>= 7;
+    } while (arg);
+  }
+  if (RAM_TRACE_HEADER_SIZE + length() + n > m_size) {
+    m_overflow = true;
+    return;
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    if (m_count == sizeof(m_buf) && !flushBuf()) {
+      m_overflow = true;
+      return;
+    }
+    m_buf[m_count++] = rec[i];
+  }
+}
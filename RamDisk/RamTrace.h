@@ -0,0 +1,130 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef RamTrace_h
+#define RamTrace_h
+/**
+ * \file
+ * RamTrace class
+ */
+#include <Arduino.h>
+#include <RamBaseDevice.h>
+#include <RamDiskConfig.h>
+//------------------------------------------------------------------------------
+/** Value of the first four bytes of a trace region. */
+uint32_t const RAM_TRACE_MAGIC = 0X43525452;
+/** Size of the trace region header, magic then length of the records. */
+uint8_t const RAM_TRACE_HEADER_SIZE = 8;
+/** Number of files that can be traced at the same time. */
+uint8_t const RAM_TRACE_FILES = 8;
+/** Record type - open, oflag byte then 11 byte directory name follow. */
+uint8_t const RAM_TRACE_OPEN = 1;
+/** Record type - close. */
+uint8_t const RAM_TRACE_CLOSE = 2;
+/** Record type - read, count follows. */
+uint8_t const RAM_TRACE_READ = 3;
+/** Record type - write, count follows. */
+uint8_t const RAM_TRACE_WRITE = 4;
+/** Record type - seekSet() or rewind(), position follows. */
+uint8_t const RAM_TRACE_SEEK = 5;
+/** Record type - sync. */
+uint8_t const RAM_TRACE_SYNC = 6;
+/** Record type - truncate, length follows. */
+uint8_t const RAM_TRACE_TRUNCATE = 7;
+/** Record type - remove an open file. */
+uint8_t const RAM_TRACE_REMOVE = 8;
+//------------------------------------------------------------------------------
+/**
+ * \class RamTrace
+ * \brief Record RamBaseFile calls in a region of a device.
+ *
+ * Set RAM_DISK_TRACE nonzero in RamDiskConfig.h to enable recording.
+ * Only calls made by the application are recorded, not calls made by
+ * other RamBaseFile functions.  File data is not recorded.
+ *
+ * A record starts with a byte that has the record type in the high five
+ * bits and a file number in the low three bits.  Counts, positions and
+ * lengths follow as base 128 varints, low seven bits first.  The file
+ * number is assigned by the open record and released by close or remove.
+ * Files opened before begin() are not traced.
+ *
+ * Recording stops when the region is full.  The header is written by
+ * end().  Use printHex() to copy the trace to a host for replay.
+ */
+class RamTrace {
+ public:
+  /** Create an inactive trace. */
+  RamTrace() : m_dev(0) {}
+  bool begin(RamBaseDevice* dev, uint32_t address, uint32_t size);
+  bool end();
+  /** \return The active trace or null if no trace is active. */
+  static RamTrace* current() {return m_current;}
+  /** \return Number of bytes of records. */
+  uint32_t length() {return m_length + m_count;}
+  /** \return true if records were dropped because the region was full. */
+  bool overflow() {return m_overflow;}
+  bool printHex(Print* pr);
+  void record(const void* file, uint8_t type, uint32_t arg,
+              const uint8_t* name);
+
+ private:
+  friend class RamTraceCall;
+  bool flushBuf();
+  static uint8_t m_depth;      // RamBaseFile call nesting
+  static RamTrace* m_current;  // active trace
+  RamBaseDevice* m_dev;        // device for the trace region
+  uint32_t m_address;          // start of trace region
+  uint32_t m_size;             // size of trace region
+  uint32_t m_length;           // record bytes written to the device
+  const void* m_file[RAM_TRACE_FILES];  // files for file numbers
+  bool m_overflow;             // records were dropped
+  uint8_t m_count;             // bytes in m_buf
+  uint8_t m_buf[32];           // records not yet written to the device
+};
+//------------------------------------------------------------------------------
+/**
+ * \class RamTraceCall
+ * \brief Record a call if it is not made from another traced call.
+ */
+class RamTraceCall {
+ public:
+  /**
+   * Record a call to the active trace.
+   *
+   * \param[in] file The RamBaseFile called.
+   * \param[in] type Record type.
+   * \param[in] arg Count, position, length or oflag.
+   * \param[in] name Directory name for RAM_TRACE_OPEN.
+   */
+  RamTraceCall(const void* file, uint8_t type, uint32_t arg = 0,
+               const uint8_t* name = 0) {
+    if (RamTrace::m_depth++ == 0 && RamTrace::m_current) {
+      RamTrace::m_current->record(file, type, arg, name);
+    }
+  }
+  ~RamTraceCall() {RamTrace::m_depth--;}
+};
+//------------------------------------------------------------------------------
+#if RAM_DISK_TRACE
+/** Trace a RamBaseFile call. */
+#define RAM_TRACE_CALL(args) RamTraceCall ramTraceCall args
+#else  // RAM_DISK_TRACE
+#define RAM_TRACE_CALL(args)
+#endif  // RAM_DISK_TRACE
+#endif  // RamTrace_h
@@ -26,26 +26,55 @@
 //------------------------------------------------------------------------------
 RamVolume* RamVolume::m_curVol = 0;
 //------------------------------------------------------------------------------
-bool RamVolume::allocCluster(fat_t* cluster) {
-  fat_t freeCluster = m_allocStartCluster;
-  for (fat_t i = 0; ; i++) {
-    // return no free clusters
-    if (i >= m_clusterCount) {
-      DBG_FAIL_MACRO;
-      goto fail;
-    }
-    // Fat has clusterCount + 2 entries
-    if (freeCluster > m_clusterCount) freeCluster = 1;
-    freeCluster++;
+// Allocate a cluster and link it after *cluster if *cluster is not zero.
+// If slot is a window, the cluster is taken from the file's window or a
+// new window is started.
+bool RamVolume::allocCluster(fat_t* cluster, uint8_t slot) {
+  fat_t freeCluster = 0;
+  bool pending = false;
+#if RAM_DISK_RESERVE_SLOTS
+  if (slot < RAM_DISK_RESERVE_SLOTS && m_freeCount != 0) {
     fat_t value;
-    if (!fatGet(freeCluster, &value)) {
+    // Try the next cluster in the window then the cluster after the file.
+    fat_t next = m_windowNext[slot];
+    if (next >= m_windowEnd[slot]) next = *cluster ? *cluster + 1 : 0;
+    if (next >= 2 && next <= (m_clusterCount + 1) && !windowed(next, slot)) {
+      if (!fatGet(next, &value)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (value == 0) freeCluster = next;
+    }
+  }
+#endif  // RAM_DISK_RESERVE_SLOTS
+  if (freeCluster == 0 && m_freeCount != 0) findFree(&freeCluster, slot);
+  if (freeCluster == 0) {
+#if RAM_DISK_PENDING_FREE_SLOTS
+    // Take the first cluster of a chain that is waiting to be freed.
+    for (uint8_t i = 0; i < RAM_DISK_PENDING_FREE_SLOTS; i++) {
+      if (m_pendingFree[i]) {
+        freeCluster = m_pendingFree[i];
+        if (!fatGet(freeCluster, &m_pendingFree[i])) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        if (isEOC(m_pendingFree[i])) m_pendingFree[i] = 0;
+        pending = true;
+        break;
+      }
+    }
+#endif  // RAM_DISK_PENDING_FREE_SLOTS
+    if (freeCluster == 0) {
       DBG_FAIL_MACRO;
       goto fail;
     }
-    if (value == 0) break;
+  }
+  if (!freeCountChanged()) {
+    DBG_FAIL_MACRO;
+    goto fail;
   }
   // mark cluster allocated
-  if (!fatPut(freeCluster, FAT16EOC)) {
+  if (!fatPut(freeCluster, RAM_DISK_EOC)) {
     DBG_FAIL_MACRO;
     goto fail;
   }
@@ -58,26 +87,699 @@ bool RamVolume::allocCluster(fat_t* cluster) {
   }
   // return first cluster number to caller
   *cluster = freeCluster;
+#if RAM_DISK_RESERVE_SLOTS
+  if (slot < RAM_DISK_RESERVE_SLOTS) {
+    if (freeCluster != m_windowNext[slot]
+      || freeCluster >= m_windowEnd[slot]) {
+      // Start a new window or grow the window past its end.
+      fat_t end = freeCluster + RAM_DISK_RESERVE_CLUSTERS;
+      if (end > (m_clusterCount + 2)) end = m_clusterCount + 2;
+      // Stop at the next window.
+      for (uint8_t i = 0; i < RAM_DISK_RESERVE_SLOTS; i++) {
+        if (i != slot && m_windowNext[i] > freeCluster
+          && m_windowNext[i] < end) {
+          end = m_windowNext[i];
+        }
+      }
+      m_windowEnd[slot] = end;
+      // Search for other files starts after the window.
+      m_allocStartCluster = end - 1;
+    }
+    m_windowNext[slot] = freeCluster + 1;
+  } else {
+    m_allocStartCluster = freeCluster;
+  }
+#else  // RAM_DISK_RESERVE_SLOTS
   m_allocStartCluster = freeCluster;
+#endif  // RAM_DISK_RESERVE_SLOTS
+  // A pending cluster was not counted as free.
+  if (!pending && m_freeCount != RAM_DISK_FREE_COUNT_UNKNOWN) m_freeCount--;
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Allocate a contiguous chain of count clusters.  The FAT is scanned in
+// bursts through buf.
+bool RamVolume::allocContiguous(fat_t count, fat_t* first, uint8_t* buf,
+                                size_t size) {
+  FatBurst fb;
+  fat_t start = 2;
+  fat_t value;
+  if (count == 0 || m_freeCount < count) return false;
+  fb.buf = buf;
+  fb.size = size;
+  fb.count = 0;
+  for (fat_t c = 2; ; c++) {
+    if ((c - start) == count) break;
+    if (c > (m_clusterCount + 1)) return false;
+    if (!fatGet(&fb, c, &value)) return false;
+    if (value != 0 || windowed(c, NO_WINDOW)) start = c + 1;
+  }
+  if (!freeCountChanged()) return false;
+  // Link from the end so the chain is complete when the first is linked.
+  value = RAM_DISK_EOC;
+  for (fat_t c = start + count; c-- > start; value = c) {
+    if (!fatPut(c, value)) return false;
+  }
+  if (m_freeCount != RAM_DISK_FREE_COUNT_UNKNOWN) m_freeCount -= count;
+  *first = start;
+  return true;
+}
+//------------------------------------------------------------------------------
+bool RamVolume::check(bool repair, uint8_t* buf, size_t size,
+                      RamCheckResult* result) {
+  dir_t dir;
+  FatBurst fb;
+  fat_t cluster;
+  fat_t next;
+  uint8_t* map = buf;
+  uint32_t mapSize = checkMapSize();
+  memset(result, 0, sizeof(RamCheckResult));
+  if (!m_volumeValid || size < (mapSize + 4)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if (repair) {
+    // A call frees at most 0XFFFF clusters.
+    while (reclaimPending()) {
+      if (!reclaim(0XFFFF)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    }
+    if (!freeCountChanged()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  memset(map, 0, mapSize);
+  fb.buf = buf + mapSize;
+  fb.size = size - mapSize;
+  fb.count = 0;
+  // One pass over the FAT.
+  for (cluster = 2; cluster <= (m_clusterCount + 1); cluster++) {
+    if (!fatGet(&fb, cluster, &next)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (next == 0) {
+      result->freeClusters++;
+      continue;
+    }
+    checkMark(map, cluster, CHECK_ALLOCATED);
+    // End of chain or bad cluster.
+    if (next >= (RAM_DISK_EOC_MIN - 1)) continue;
+    if (next < 2 || next > (m_clusterCount + 1)) {
+      result->badLinks++;
+    } else if (checkMark(map, next, CHECK_REFERENCED)) {
+      result->crossLinks++;
+    } else {
+      continue;
+    }
+    if (repair) {
+      if (!fatPut(cluster, RAM_DISK_EOC)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      fb.count = 0;
+    }
+  }
+  if (repair || m_freeCount == RAM_DISK_FREE_COUNT_UNKNOWN) {
+    // Repairs below keep the count current.
+    m_freeCount = result->freeClusters;
+    m_paramsDirty = true;
+  }
+  // Links to free clusters are only known after the pass.
+  for (cluster = 2; cluster <= (m_clusterCount + 1); cluster++) {
+    if (checkBits(map, cluster) == CHECK_REFERENCED) break;
+  }
+  if (cluster <= (m_clusterCount + 1)) {
+    // Find and end each link to a free cluster.
+    for (cluster = 2; cluster <= (m_clusterCount + 1); cluster++) {
+      if (!(checkBits(map, cluster) & CHECK_ALLOCATED)) continue;
+      if (!fatGet(&fb, cluster, &next)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (next < 2 || next > (m_clusterCount + 1)
+        || checkBits(map, next) != CHECK_REFERENCED) {
+        continue;
+      }
+      result->badLinks++;
+      if (repair) {
+        if (!fatPut(cluster, RAM_DISK_EOC)) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        fb.count = 0;
+      }
+    }
+    // Forget the links so only allocated clusters are marked.
+    for (cluster = 2; cluster <= (m_clusterCount + 1); cluster++) {
+      if (checkBits(map, cluster) == CHECK_REFERENCED) {
+        checkClear(map, cluster, CHECK_REFERENCED);
+      }
+    }
+  }
+  // Check directory entries against the map and walk file chains.
+  for (uint16_t index = 0; index < m_rootDirEntryCount; index++) {
+    bool change = false;
+    uint32_t count = 0;
+    uint32_t need;
+    if (!readDir(index, &dir)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (dir.name[0] == DIR_NAME_FREE) break;
+    if (dir.name[0] == DIR_NAME_DELETED || !DIR_IS_FILE(&dir)) continue;
+    cluster = dirCluster(&dir);
+    if (cluster) {
+      if (cluster < 2 || cluster > (m_clusterCount + 1)
+        || checkBits(map, cluster) == 0) {
+        result->badLinks++;
+        change = true;
+      } else if (checkMark(map, cluster, CHECK_REFERENCED)) {
+        result->crossLinks++;
+        change = true;
+      }
+      if (change) {
+        // Remove the file's data.
+        cluster = 0;
+        dir.fileSize = 0;
+        setDirCluster(&dir, 0);
+      }
+    }
+    need = (dir.fileSize + clusterSizeBytes() - 1)
+           >> (9 + m_clusterSizeShift);
+    for (fat_t c = cluster; c; c = next) {
+      if (!fatGet(&fb, c, &next)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      count++;
+      // Reached clusters keep only the referenced bit.
+      checkClear(map, c, CHECK_ALLOCATED);
+      if (isEOC(next)) break;
+      if (next < 2 || next > (m_clusterCount + 1)
+        || checkBits(map, next) == 0) {
+        // Bad link counted by the FAT pass.  Never follow it.
+        if (repair) {
+          if (!fatPut(c, RAM_DISK_EOC)) {
+            DBG_FAIL_MACRO;
+            goto fail;
+          }
+          fb.count = 0;
+        }
+        break;
+      }
+      if (count == need || count > m_clusterCount) {
+        // Chain is too long or loops.
+        result->sizeErrors++;
+        // Extra clusters belong to the file and are not lost.
+        for (fat_t t = next; count == need && t >= 2
+          && t <= (m_clusterCount + 1)
+          && (checkBits(map, t) & CHECK_ALLOCATED);) {
+          checkClear(map, t, CHECK_ALLOCATED);
+          if (!fatGet(&fb, t, &t)) {
+            DBG_FAIL_MACRO;
+            goto fail;
+          }
+        }
+        if (repair) {
+          if (!fatPut(c, RAM_DISK_EOC)) {
+            DBG_FAIL_MACRO;
+            goto fail;
+          }
+          if (count == need && !freeChain(next)) {
+            DBG_FAIL_MACRO;
+            goto fail;
+          }
+          fb.count = 0;
+        }
+        break;
+      }
+    }
+    if (count < need) {
+      // Chain is too short.
+      result->sizeErrors++;
+      dir.fileSize = count << (9 + m_clusterSizeShift);
+      change = true;
+    } else if (need == 0 && cluster) {
+      // Clusters for an empty file.
+      result->sizeErrors++;
+      if (repair) {
+        if (!freeChain(cluster)) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        fb.count = 0;
+      }
+      setDirCluster(&dir, 0);
+      change = true;
+    }
+    if (repair && change && !writeDir(index, &dir)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  // Allocated clusters that are not reached are lost.  Those that are
+  // not referenced start chains and those left after are in loops.
+  for (uint8_t loops = 0; loops < 2; loops++) {
+    uint8_t start = loops ? CHECK_ALLOCATED | CHECK_REFERENCED
+                          : CHECK_ALLOCATED;
+    for (cluster = 2; cluster <= (m_clusterCount + 1); cluster++) {
+      fat_t last;
+      if (checkBits(map, cluster) != start) continue;
+      result->lostChains++;
+      next = cluster;
+      do {
+        last = next;
+        if (!fatGet(&fb, last, &next)) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        result->lostClusters++;
+        checkClear(map, last, CHECK_ALLOCATED);
+        if (isEOC(next) || next < 2 || next > (m_clusterCount + 1)) break;
+      } while (checkBits(map, next) & CHECK_ALLOCATED);
+      if (repair) {
+        // End a chain that links back to a cluster already seen.
+        if ((!isEOC(next) && !fatPut(last, RAM_DISK_EOC))
+          || !freeChain(cluster)) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        fb.count = 0;
+      }
+    }
+  }
+  if (repair) {
+    result->freeClusters = m_freeCount;
+    if (!syncParams()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
   return true;
 
  fail:
   return false;
 }
 //------------------------------------------------------------------------------
+bool RamVolume::copyFile(RamVolume* srcVol, const char* name,
+                         RamVolume* dstVol, uint8_t* buf, size_t size) {
+  RamBaseFile src;
+  RamBaseFile dst;
+  dir_t srcDir;
+  dir_t dstDir;
+  fat_t first = 0;
+  fat_t old;
+  fat_t cluster;
+  fat_t next;
+  fat_t need;
+  uint32_t left;
+  uint32_t dstAddress;
+  if (srcVol == dstVol || size == 0) return false;
+  if (!src.open(srcVol, name, O_READ)) return false;
+  // Not O_TRUNC since truncate() writes the empty entry now.
+  if (!dst.open(dstVol, name, O_CREAT | O_WRITE)) return false;
+  left = src.fileSize();
+  need = left ? ((left - 1) >> (9 + dstVol->m_clusterSizeShift)) + 1 : 0;
+  if (need == 0 || !dstVol->allocContiguous(need, &first, buf, size)) {
+    first = 0;
+    // No data or no contiguous space, copy through the file API.
+    if (!dst.truncate(0)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    while (left) {
+      size_t n = left < size ? left : size;
+      if (src.read(buf, n) != (int)n || dst.write(buf, n) != (int)n) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      left -= n;
+    }
+    goto done;
+  }
+  dstAddress = dstVol->clusterAddress(first);
+  cluster = src.m_firstCluster;
+  while (left) {
+    // Extend the run while source clusters are contiguous.
+    uint32_t srcAddress = srcVol->clusterAddress(cluster);
+    uint32_t run = srcVol->clusterSizeBytes();
+    while (run < left) {
+      if (!srcVol->fatGet(cluster, &next)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (next != (cluster + 1)) break;
+      cluster = next;
+      run += srcVol->clusterSizeBytes();
+    }
+    if (run > left) run = left;
+    left -= run;
+    while (run) {
+      size_t n = run < size ? run : size;
+      if (!srcVol->read(srcAddress, buf, n)
+        || !dstVol->write(dstAddress, buf, n)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      srcAddress += n;
+      dstAddress += n;
+      run -= n;
+    }
+    if (left) {
+      if (!srcVol->fatGet(cluster, &next)
+        || next < 2 || srcVol->isEOC(next)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      cluster = next;
+    }
+  }
+  // Replace the old chain and size with one directory write.
+  old = dst.m_firstCluster;
+  dst.m_firstCluster = first;
+  dst.m_curCluster = 0;
+  dst.m_fileSize = src.fileSize();
+  dst.m_flags |= RamBaseFile::F_FILE_DIR_DIRTY;
+  first = 0;
+  if (!dst.close() || (old && !dstVol->freeLater(old))) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+
+ done:
+  if (dst.isOpen() && !dst.close()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  // Copy dates.
+  if (!srcVol->readDir(src.m_dirEntryIndex, &srcDir)
+    || !dstVol->readDir(dst.m_dirEntryIndex, &dstDir)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  dstDir.creationTimeTenths = srcDir.creationTimeTenths;
+  dstDir.creationTime = srcDir.creationTime;
+  dstDir.creationDate = srcDir.creationDate;
+  dstDir.lastAccessDate = srcDir.lastAccessDate;
+  dstDir.lastWriteTime = srcDir.lastWriteTime;
+  dstDir.lastWriteDate = srcDir.lastWriteDate;
+  return dstVol->writeDir(dst.m_dirEntryIndex, &dstDir);
+
+ fail:
+  dst.close();
+  // Free a chain that was never linked to the file.
+  if (first) dstVol->freeChain(first);
+  return false;
+}
+//------------------------------------------------------------------------------
+bool RamVolume::defragBegin(RamDefragState* state) {
+  state->fragmentsBefore = fragmentCount();
+  state->fragmentsAfter = 0;
+  state->movedCount = 0;
+  state->target = 2;
+  state->cluster = 0;
+  state->prev = 0;
+  state->dirIndex = 0;
+  state->freeHint = m_clusterCount + 1;
+  return m_volumeValid;
+}
+//------------------------------------------------------------------------------
+int8_t RamVolume::defragment(RamDefragState* state, uint8_t* buf,
+                             size_t size) {
+  dir_t dir;
+  FatBurst fb;
+  fat_t next;
+  fat_t parent;
+  uint16_t index;
+  if (!m_volumeValid || size < sizeof(dir_t)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if (reclaimPending()) {
+    // Removed chains would look like lost clusters.
+    if (!reclaim(1)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    state->freeHint = m_clusterCount + 1;
+    return RAM_DEFRAG_BUSY;
+  }
+  if (state->cluster == 0) {
+    // Find the next file with data.
+    for (;; state->dirIndex++) {
+      if (state->dirIndex >= m_rootDirEntryCount) goto done;
+      if (!readDir(state->dirIndex, &dir)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (dir.name[0] == DIR_NAME_FREE) goto done;
+      if (dir.name[0] != DIR_NAME_DELETED && DIR_IS_FILE(&dir)
+        && dirCluster(&dir) != 0) {
+        break;
+      }
+    }
+    state->cluster = dirCluster(&dir);
+    state->prev = 0;
+  }
+  if (state->cluster != state->target) {
+    if (!fatGet(state->target, &next)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    if (next != 0) {
+      // Make room at target.  The current file may link to it.
+      if (!fatGet(state->cluster, &parent)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (parent == state->target) {
+        parent = state->cluster;
+      } else if (!findParent(state->target, &parent, &index, buf, size)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      if (parent == 0 && index >= m_rootDirEntryCount) {
+        // Lost cluster, free it.
+        if (!freeCountChanged() || !fatPut(state->target, 0)) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        if (m_freeCount != RAM_DISK_FREE_COUNT_UNKNOWN) m_freeCount++;
+        return RAM_DEFRAG_BUSY;
+      }
+      // Search down from the hint in windows that fit in buf.
+      fat_t span = (size - 4)/fatEntryBytes();
+      fb.buf = buf;
+      fb.size = size;
+      next = state->freeHint;
+      while (next > state->target) {
+        fat_t low = next - state->target > span ? next - span + 1
+                                                : state->target + 1;
+        fat_t value;
+        fb.count = 0;
+        if (!fatGet(&fb, low, &value)) {
+          DBG_FAIL_MACRO;
+          goto fail;
+        }
+        for (; next >= low; next--) {
+          if (!fatGet(&fb, next, &value)) {
+            DBG_FAIL_MACRO;
+            goto fail;
+          }
+          if (value == 0) break;
+        }
+        if (next >= low) break;
+      }
+      if (next <= state->target) {
+        // No free cluster.
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      state->freeHint = next - 1;
+      if (!moveCluster(state->target, next, parent, index, buf, size)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      return RAM_DEFRAG_BUSY;
+    }
+    if (!moveCluster(state->cluster, state->target, state->prev,
+                     state->dirIndex, buf, size)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    // The old place of the cluster is free.
+    if (state->cluster > state->freeHint) state->freeHint = state->cluster;
+    state->cluster = state->target;
+    state->movedCount++;
+  }
+  // Cluster is in place, advance to the next cluster of the file.
+  if (!fatGet(state->cluster, &next)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  state->prev = state->cluster;
+  state->target++;
+  if (isEOC(next)) {
+    state->cluster = 0;
+    state->dirIndex++;
+  } else {
+    state->cluster = next;
+  }
+  return RAM_DEFRAG_BUSY;
+
+ done:
+  // Free space starts after the packed files.
+  m_allocStartCluster = state->target - 1;
+  state->fragmentsAfter = fragmentCount();
+  if (!syncParams()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  return RAM_DEFRAG_DONE;
+
+ fail:
+  return RAM_DEFRAG_ERROR;
+}
+//------------------------------------------------------------------------------
 bool RamVolume::fatGet(fat_t cluster, fat_t* value) {
+  uint8_t entry[4];
   if (cluster > (m_clusterCount + 1)) return false;
-  return m_ramDev->read(fatAddress(cluster), value, 2);
+  if (!m_ramDev->read(fatAddress(cluster), entry, fatEntryBytes())) {
+    return false;
+  }
+  *value = fatDecode(cluster, entry);
+  return true;
+}
+//------------------------------------------------------------------------------
+// Get a FAT entry through a buffer that is filled with a burst of FAT
+// bytes starting at the entry if the entry is not in the buffer.
+bool RamVolume::fatGet(FatBurst* fb, fat_t cluster, fat_t* value) {
+  uint32_t address = fatAddress(cluster);
+  uint8_t n = fatEntryBytes();
+  if (cluster > (m_clusterCount + 1)) return false;
+  if (address < fb->address || (address + n) > (fb->address + fb->count)) {
+    uint32_t end = 512*(FAT_START_BLOCK + fatSize());
+    fb->address = address;
+    fb->count = end - address < fb->size ? end - address : fb->size;
+    if (!m_ramDev->read(address, fb->buf, fb->count)) {
+      fb->count = 0;
+      return false;
+    }
+  }
+  *value = fatDecode(cluster, fb->buf + (address - fb->address));
+  return true;
+}
+//------------------------------------------------------------------------------
+// Convert the bytes of a FAT entry to a value.
+fat_t RamVolume::fatDecode(fat_t cluster, const uint8_t* entry) {
+  uint16_t tmp;
+  // Only 32-bit builds have 32-bit volumes.
+  if (m_fatType == 32) {
+    fat_t value;
+    memcpy(&value, entry, sizeof(fat_t));
+    return value;
+  }
+  memcpy(&tmp, entry, 2);
+  if (m_fatType == 12) {
+    tmp = cluster & 1 ? tmp >> 4 : tmp & 0XFFF;
+    // Extend bad cluster and EOC values to their FAT16 equivalents.
+    if (tmp >= 0XFF7) tmp |= 0XF000;
+  }
+  // Extend FAT16 bad cluster and EOC values to the width of fat_t.
+  return tmp < 0XFFF7 ? tmp : RAM_DISK_EOC_MIN - 0XFFF8 + tmp;
 }
 //------------------------------------------------------------------------------
 bool RamVolume::fatPut(fat_t cluster, fat_t value) {
   if (cluster < 2 || cluster > (m_clusterCount + 1)) return false;
-  return m_ramDev->write(fatAddress(cluster), &value, 2);
+  if (m_fatType == 12) {
+    uint16_t tmp;
+    uint32_t address = fatAddress(cluster);
+    if (!m_ramDev->read(address, &tmp, 2)) return false;
+    if (cluster & 1) {
+      tmp = (tmp & 0X000F) | (value << 4);
+    } else {
+      tmp = (tmp & 0XF000) | (value & 0XFFF);
+    }
+    return write(address, &tmp, 2);
+  }
+  if (m_fatType == 16) {
+    uint16_t tmp = value;
+    return write(fatAddress(cluster), &tmp, 2);
+  }
+  return write(fatAddress(cluster), &value, sizeof(fat_t));
+}
+//------------------------------------------------------------------------------
+// Find a free cluster after m_allocStartCluster.  Clusters in the windows
+// of other files are used only if no other cluster is free.
+bool RamVolume::findFree(fat_t* cluster, uint8_t slot) {
+  for (uint8_t pass = 0; pass < 2; pass++) {
+    fat_t freeCluster = m_allocStartCluster;
+    for (fat_t i = 0; i < m_clusterCount; i++) {
+      // Fat has clusterCount + 2 entries
+      if (freeCluster > m_clusterCount) freeCluster = 1;
+      freeCluster++;
+      if (pass == 0 && windowed(freeCluster, slot)) continue;
+      fat_t value;
+      if (!fatGet(freeCluster, &value)) return false;
+      if (value == 0) {
+        *cluster = freeCluster;
+        return true;
+      }
+    }
+    if (!RAM_DISK_RESERVE_SLOTS) break;
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+// Find the FAT entry or directory entry that links to a cluster.  If the
+// cluster is lost, parent is zero and index is rootDirEntryCount().  The
+// FAT and directory are read in bursts through buf.
+bool RamVolume::findParent(fat_t cluster, fat_t* parent, uint16_t* index,
+                           uint8_t* buf, size_t size) {
+  FatBurst fb;
+  fb.buf = buf;
+  fb.size = size;
+  fb.count = 0;
+  *index = m_rootDirEntryCount;
+  for (fat_t i = 2; i < (m_clusterCount + 2); i++) {
+    fat_t next;
+    if (!fatGet(&fb, i, &next)) return false;
+    if (next == cluster) {
+      *parent = i;
+      return true;
+    }
+  }
+  *parent = 0;
+  uint16_t n = size/sizeof(dir_t);
+  for (uint16_t i = 0; i < m_rootDirEntryCount; i += n) {
+    uint16_t k = m_rootDirEntryCount - i < n ? m_rootDirEntryCount - i : n;
+    if (!read(dirAddress(i), buf, k*sizeof(dir_t))) return false;
+    for (uint16_t j = 0; j < k; j++) {
+      dir_t* dir = reinterpret_cast<dir_t*>(buf) + j;
+      if (dir->name[0] == DIR_NAME_FREE) return true;
+      if (dir->name[0] != DIR_NAME_DELETED && DIR_IS_FILE(dir)
+        && dirCluster(dir) == cluster) {
+        *index = i + j;
+        return true;
+      }
+    }
+  }
+  return true;
 }
 //------------------------------------------------------------------------------
 bool RamVolume::format(RamBaseDevice* dev, uint32_t totalBlocks,
-                     uint8_t dirBlocks, uint8_t blocksPerCluster) {
+                     uint8_t dirBlocks, uint8_t blocksPerCluster,
+                     uint8_t options) {
   RamDiskParams params;
+  bool fatBoot = options & RAM_FORMAT_FAT_BOOT;
+  uint8_t fatType;
   params.version = RAM_DISK_PARAMS_VERSION;
   if (totalBlocks == 0) totalBlocks = dev->sizeBlocks();
   if (dirBlocks == 0 || totalBlocks < (dirBlocks + blocksPerCluster + 2UL)) {
@@ -94,74 +796,229 @@ bool RamVolume::format(RamBaseDevice* dev, uint32_t totalBlocks,
   // Round to integral number of clusters.
   totalBlocks = (totalBlocks >> shift) << shift;
 
-  uint16_t dataStart;
-  uint16_t dirStart;
-  uint32_t nc;
-  for (dataStart = blocksPerCluster;; dataStart += blocksPerCluster) {
-    nc = (totalBlocks - dataStart)/blocksPerCluster;
-    uint16_t fatSize = (nc + 2 + 255)/256;
-    // Error if too many clusters.
-    if (fatSize > 255) return false;
-    dirStart = FAT_START_BLOCK + fatSize;
-    // Space required before data.
-    uint16_t r = dirStart + dirBlocks;
-    if (dataStart >= r) break;
+  if (!formatGeometry(totalBlocks, dirBlocks, fatBoot, &params, &fatType)) {
+    return false;
   }
-  params.rootDirStartBlock = dirStart;
-  params.dataStartBlock = dataStart;
-  params.clusterCount = nc;
-
-  fat_t fat[2];
-  fat[0] = fat[1] = 0;
+  uint32_t dataStart = params.dataStartBlock;
+  uint32_t dirStart = params.rootDirStartBlock;
+  uint32_t fatSize = dirStart - FAT_START_BLOCK;
+  uint32_t nc = params.clusterCount;
+  params.freeCount = nc;
+  params.nextFree = 2;
 
-  // Zero parameter block, FAT, and directory.
-  uint32_t addLimit = 512UL*dataStart;
-  for (uint32_t add = 0; add < addLimit; add += sizeof(fat)) {
-    if (!dev->write(add, fat, sizeof(fat))) return false;
-  }
-  // Save parameters at address zero.
-  if (!dev->write(0, &params, sizeof(params))) return false;
-  fat[0] = fat[1] = 0XFFFF;
+  // FAT entries zero and one.
+  uint8_t fat[8];
+  memset(fat, 0XFF, sizeof(fat));
 
+  if (options & RAM_FORMAT_QUICK) {
+    // Zero parameter block, FAT, and the directory end marker.
+    if (!dev->fill(0, 0, 512UL*dirStart + sizeof(dir_t))) return false;
+  } else {
+    // Zero parameter block, FAT, and directory.
+    if (!dev->fill(0, 0, 512UL*dataStart)) return false;
+  }
+  if (fatBoot) {
+    // Only fields before bootCode are written, the rest are zero.
+    uint8_t bpb[offsetof(fat_boot_t, bootCode)];
+    fat_boot_t* pb = reinterpret_cast<fat_boot_t*>(bpb);
+    memset(bpb, 0, sizeof(bpb));
+    pb->jump[0] = 0XEB;
+    pb->jump[1] = 0X3C;
+    pb->jump[2] = 0X90;
+    memcpy(pb->oemId, "RAMDISK ", sizeof(pb->oemId));
+    pb->bytesPerSector = 512;
+    pb->sectorsPerCluster = blocksPerCluster;
+    pb->reservedSectorCount = FAT_START_BLOCK;
+    pb->fatCount = 1;
+    // Padding before the data area is part of the root directory.
+    pb->rootDirEntryCount = 16*(dataStart - dirStart);
+    if (totalBlocks < 0X10000) {
+      pb->totalSectors16 = totalBlocks;
+    } else {
+      pb->totalSectors32 = totalBlocks;
+    }
+    pb->mediaType = 0XF8;
+    pb->sectorsPerFat16 = fatSize;
+    pb->sectorsPerTrack = 32;
+    pb->headCount = 2;
+    pb->driveNumber = 0X80;
+    pb->bootSignature = EXTENDED_BOOT_SIG;
+    memcpy(pb->volumeLabel, "NO NAME    ", sizeof(pb->volumeLabel));
+    memcpy(pb->fileSystemType, fatType == 12 ? "FAT12   " : "FAT16   ",
+           sizeof(pb->fileSystemType));
+    if (!dev->write(0, bpb, sizeof(bpb))) return false;
+    bpb[0] = BOOTSIG0;
+    bpb[1] = BOOTSIG1;
+    if (!dev->write(510, bpb, 2)) return false;
+    // Media type in the first entry.
+    fat[0] = 0XF8;
+  } else {
+    // Save parameters at address zero.
+    if (!dev->write(0, &params, sizeof(params))) return false;
+  }
   // Reserve first two FAT entries. (like real FAT - could use just one).
-  if (!dev->write(512*FAT_START_BLOCK, &fat, sizeof(fat))) return false;
+  // FAT12 entries zero and one use three bytes.
+  uint8_t n = fatType == 12 ? 3 : fatType/4;
+  return dev->write(512*FAT_START_BLOCK, fat, n);
+}
+//------------------------------------------------------------------------------
+bool RamVolume::formatForWorkload(RamBaseDevice* dev,
+                                  const RamWorkload* workload,
+                                  RamFormatPlan* plan) {
+  RamFormatPlan tmp;
+  if (!plan) plan = &tmp;
+  if (!planFormat(dev->sizeBlocks(), workload, plan)) return false;
+  return format(dev, 0, plan->dirBlocks, plan->blocksPerCluster,
+                workload->options);
+}
+//------------------------------------------------------------------------------
+// Find the start of the directory and data and the cluster count for a
+// volume of totalBlocks, a multiple of the cluster size.  The cluster
+// size shift is taken from params.
+bool RamVolume::formatGeometry(uint32_t totalBlocks, uint8_t dirBlocks,
+                               bool fatBoot, RamDiskParams* params,
+                               uint8_t* fatType) {
+  uint8_t shift = params->clusterSizeShift;
+  uint32_t dataStart;
+  uint32_t dirStart;
+  uint32_t nc;
+  for (dataStart = 1UL << shift;; dataStart += 1UL << shift) {
+    if (dataStart >= totalBlocks) return false;
+    nc = (totalBlocks - dataStart) >> shift;
+    if (fatBoot) {
+      // A FAT boot sector volume must use FAT12 for small cluster counts.
+      *fatType = nc < 4085 ? 12 : 16;
+    } else {
+      *fatType = RAM_DISK_USE_32_BIT_FAT ? 32 : 16;
+    }
+    uint32_t fatBytes = *fatType == 12 ? (3*(nc + 2) + 1)/2
+                                       : (*fatType/8)*(nc + 2);
+    // Error if too many clusters for 16-bit entries.
+    if (*fatType != 32 && fatBytes > 255*512UL) return false;
+    dirStart = FAT_START_BLOCK + (fatBytes + 511)/512;
+    // Space required before data.
+    if (dataStart >= (dirStart + dirBlocks)) break;
+  }
+  params->rootDirStartBlock = dirStart;
+  params->dataStartBlock = dataStart;
+  params->clusterCount = nc;
   return true;
 }
 //------------------------------------------------------------------------------
+uint32_t RamVolume::fragmentCount() {
+  dir_t dir;
+  uint32_t count = 0;
+  for (uint16_t index = 0; index < m_rootDirEntryCount; index++) {
+    if (!readDir(index, &dir)) return 0;
+    if (dir.name[0] == DIR_NAME_FREE) break;
+    if (dir.name[0] == DIR_NAME_DELETED || !DIR_IS_FILE(&dir)) continue;
+    fat_t cluster = dirCluster(&dir);
+    if (cluster == 0) continue;
+    count++;
+    // Limit the walk in case of a loop.
+    for (fat_t n = 0; n < m_clusterCount; n++) {
+      fat_t next;
+      if (!fatGet(cluster, &next)) return 0;
+      if (isEOC(next)) break;
+      if (next != (cluster + 1)) count++;
+      cluster = next;
+    }
+  }
+  return count;
+}
+//------------------------------------------------------------------------------
+// Free a chain now or, if a slot is available, detach it for reclaim().
+bool RamVolume::freeLater(fat_t cluster) {
+#if RAM_DISK_PENDING_FREE_SLOTS
+  for (uint8_t i = 0; i < RAM_DISK_PENDING_FREE_SLOTS; i++) {
+    if (m_pendingFree[i] == 0) {
+      m_pendingFree[i] = cluster;
+      return true;
+    }
+  }
+#endif  // RAM_DISK_PENDING_FREE_SLOTS
+  return freeChain(cluster);
+}
+//------------------------------------------------------------------------------
 // free a cluster chain
 bool RamVolume::freeChain(fat_t cluster) {
-  while (1) {
-    fat_t next;
-    if (!fatGet(cluster, &next)) return false;
-    if (!fatPut(cluster, 0)) return false;
-    if (cluster <= m_allocStartCluster) m_allocStartCluster = cluster - 1;
-    if (isEOC(next)) return true;
-    cluster = next;
+  if (!freeCountChanged()) return false;
+  while (cluster) {
+    if (!freeCluster(cluster, &cluster)) return false;
   }
+  return true;
 }
 //------------------------------------------------------------------------------
-uint16_t RamVolume::freeClusterCount() {
-  uint16_t free = 0;
+// Free one cluster.  Next is the next cluster in the chain or zero.
+bool RamVolume::freeCluster(fat_t cluster, fat_t* next) {
+  if (!fatGet(cluster, next)) return false;
+  if (!fatPut(cluster, 0)) return false;
+  if (m_freeCount != RAM_DISK_FREE_COUNT_UNKNOWN) m_freeCount++;
+  if (cluster <= m_allocStartCluster) m_allocStartCluster = cluster - 1;
+  if (isEOC(*next)) *next = 0;
+  return true;
+}
+//------------------------------------------------------------------------------
+fat_t RamVolume::freeClusterCount() {
+  fat_t free = 0;
+  if (m_freeCount != RAM_DISK_FREE_COUNT_UNKNOWN) return m_freeCount;
   // Fat has clusterCount + 2 entries.  First two are dummy
   for (fat_t i = 2; i < (m_clusterCount + 2); i++) {
     fat_t f;
     if (!fatGet(i, &f)) return 0;
     if (f == 0) free++;
   }
+  m_freeCount = free;
+  // Save the count at the next sync.
+  m_paramsDirty = true;
   return free;
 }
 //------------------------------------------------------------------------------
+// Called before the FAT is changed.  The first change after a sync marks
+// the saved free count unknown so a crash can't leave a wrong count.
+bool RamVolume::freeCountChanged() {
+  if (m_paramsDirty || !m_paramsPersist) return true;
+  fat_t unknown = RAM_DISK_FREE_COUNT_UNKNOWN;
+  m_paramsDirty = true;
+  return write(offsetof(RamDiskParams, freeCount), &unknown, sizeof(fat_t));
+}
+//------------------------------------------------------------------------------
 bool RamVolume::init(RamBaseDevice* dev) {
   RamDiskParams params;
   if (!dev->read(0, &params, sizeof(params))) {
     DBG_FAIL_MACRO;
     return false;
   }
-  if (params.version != RAM_DISK_PARAMS_VERSION
-    || params.clusterSizeShift > 6
-    || params.rootDirStartBlock >= params.dataStartBlock) {
+#if RAM_DISK_USE_32_BIT_FAT
+  if (params.version == RAM_DISK_PARAMS_VERSION) {
+#else  // RAM_DISK_USE_32_BIT_FAT
+  if (params.version == RAM_DISK_PARAMS_VERSION
+    || params.version == RAM_DISK_PARAMS_VERSION_20140427) {
+#endif  // RAM_DISK_USE_32_BIT_FAT
+    if (params.clusterSizeShift > 6
+      || params.rootDirStartBlock >= params.dataStartBlock) {
+      DBG_FAIL_MACRO;
+      return false;
+    }
+    m_fatType = RAM_DISK_USE_32_BIT_FAT ? 32 : 16;
+    m_paramsPersist = params.version == RAM_DISK_PARAMS_VERSION;
+  } else if (!readBootSector(dev, &params)) {
     DBG_FAIL_MACRO;
     return false;
+  } else {
+    // No place for freeCount or nextFree in a boot sector.
+    m_paramsPersist = false;
+  }
+  if (!m_paramsPersist) {
+    params.freeCount = RAM_DISK_FREE_COUNT_UNKNOWN;
+    params.nextFree = 2;
+  }
+  // Validate the saved values.
+  if (params.freeCount > params.clusterCount) {
+    params.freeCount = RAM_DISK_FREE_COUNT_UNKNOWN;
+  }
+  if (params.nextFree < 2 || params.nextFree > (params.clusterCount + 1)) {
+    params.nextFree = 2;
   }
   m_clusterSizeShift = params.clusterSizeShift;
   m_clusterOffsetMask = (1UL << (9 + m_clusterSizeShift)) - 1;
@@ -172,10 +1029,99 @@ bool RamVolume::init(RamBaseDevice* dev) {
   m_ramDev = dev;
   m_volumeValid = true;
   m_curVol = this;
-  m_allocStartCluster = 1;
+  // Search starts after m_allocStartCluster.
+  m_allocStartCluster = params.nextFree - 1;
+  m_freeCount = params.freeCount;
+  m_paramsDirty = false;
+#if RAM_DISK_RESERVE_SLOTS
+  for (uint8_t i = 0; i < RAM_DISK_RESERVE_SLOTS; i++) windowClose(i);
+#endif  // RAM_DISK_RESERVE_SLOTS
+#if RAM_DISK_PENDING_FREE_SLOTS
+  memset(m_pendingFree, 0, sizeof(m_pendingFree));
+#endif  // RAM_DISK_PENDING_FREE_SLOTS
+  return true;
+}
+//------------------------------------------------------------------------------
+// Count free runs in one pass over the FAT then walk each file chain.
+// Files are listed on pr if pr is not null.
+bool RamVolume::layout(RamLayoutStats* stats, uint8_t* buf, size_t size,
+                       Print* pr) {
+  dir_t dir;
+  FatBurst fb;
+  fat_t run = 0;
+  memset(stats, 0, sizeof(RamLayoutStats));
+  if (!m_volumeValid || size < 4) {
+    DBG_FAIL_MACRO;
+    return false;
+  }
+  fb.buf = buf;
+  fb.size = size;
+  fb.count = 0;
+  // The step after the last cluster ends the last run.
+  for (fat_t c = 2; c <= (m_clusterCount + 2); c++) {
+    fat_t value = RAM_DISK_EOC;
+    if (c <= (m_clusterCount + 1) && !fatGet(&fb, c, &value)) {
+      DBG_FAIL_MACRO;
+      return false;
+    }
+    if (value == 0) {
+      run++;
+      continue;
+    }
+    if (run == 0) continue;
+    uint8_t i = 0;
+    while (i < (RAM_LAYOUT_HIST_BUCKETS - 1) && (run >> (i + 1))) i++;
+    stats->freeHist[i]++;
+    stats->freeClusters += run;
+    stats->freeExtents++;
+    if (run > stats->largestFreeRun) stats->largestFreeRun = run;
+    run = 0;
+  }
+  for (uint16_t index = 0; index < m_rootDirEntryCount; index++) {
+    if (!readDir(index, &dir)) {
+      DBG_FAIL_MACRO;
+      return false;
+    }
+    if (dir.name[0] == DIR_NAME_FREE) break;
+    if (dir.name[0] == DIR_NAME_DELETED || !DIR_IS_FILE(&dir)) continue;
+    fat_t cluster = dirCluster(&dir);
+    uint32_t clusters = 0;
+    uint32_t extents = cluster ? 1 : 0;
+    // Limit the walk in case of a loop.
+    for (; cluster && clusters < m_clusterCount; clusters++) {
+      fat_t next;
+      if (!fatGet(&fb, cluster, &next)) {
+        DBG_FAIL_MACRO;
+        return false;
+      }
+      if (isEOC(next)) {
+        next = 0;
+      } else if (next != (cluster + 1)) {
+        extents++;
+      }
+      cluster = next;
+    }
+    if (pr) {
+      RamBaseFile::printDirName(pr, dir, 14);
+      pr->print(clusters);
+      pr->write(' ');
+      pr->println(extents);
+    }
+    if (clusters == 0) continue;
+    stats->files++;
+    stats->fileClusters += clusters;
+    stats->extents += extents;
+    if (extents > 1) stats->fragmentedFiles++;
+    if (extents > stats->maxFileExtents) stats->maxFileExtents = extents;
+  }
   return true;
 }
 //------------------------------------------------------------------------------
+bool RamVolume::layoutStats(RamLayoutStats* stats, uint8_t* buf,
+                            size_t size) {
+  return layout(stats, buf, size, 0);
+}
+//------------------------------------------------------------------------------
 void RamVolume::ls(Print* pr, uint8_t flags) {
   dir_t d;
   for (uint16_t index = 0; index < rootDirEntryCount(); index++) {
@@ -200,8 +1146,115 @@ void RamVolume::ls(Print* pr, uint8_t flags) {
   }
 }
 //------------------------------------------------------------------------------
+// Set the dirty bit for each region touched by a write.
+void RamVolume::markDirty(uint32_t address, size_t nbyte) {
+  if (nbyte == 0) return;
+  uint32_t first = address >> 9;
+  uint32_t last = (address + nbyte - 1) >> 9;
+  if (first >= m_dataStartBlock) {
+    first = m_dataStartBlock
+            + ((first - m_dataStartBlock) >> m_clusterSizeShift);
+  }
+  if (last >= m_dataStartBlock) {
+    last = m_dataStartBlock
+           + ((last - m_dataStartBlock) >> m_clusterSizeShift);
+  }
+  for (uint32_t i = first; i <= last; i++) {
+    m_dirtyMap[i >> 3] |= 1 << (i & 7);
+  }
+}
+//------------------------------------------------------------------------------
+// Copy a cluster to a free cluster and replace it in its chain.  The chain
+// is linked from the FAT entry parent or, if parent is zero, from the
+// directory entry index.
+bool RamVolume::moveCluster(fat_t from, fat_t to, fat_t parent,
+                            uint16_t index, uint8_t* buf, size_t size) {
+  uint32_t src = clusterAddress(from);
+  uint32_t dst = clusterAddress(to);
+  uint32_t left = clusterSizeBytes();
+  fat_t next;
+  while (left) {
+    size_t n = left < size ? left : size;
+    if (!read(src, buf, n) || !write(dst, buf, n)) return false;
+    src += n;
+    dst += n;
+    left -= n;
+  }
+  if (!fatGet(from, &next) || !freeCountChanged()) return false;
+  // The copy is allocated before it is linked.
+  if (!fatPut(to, next)) return false;
+  if (parent) {
+    if (!fatPut(parent, to)) return false;
+  } else {
+    dir_t dir;
+    if (!readDir(index, &dir)) return false;
+    setDirCluster(&dir, to);
+    if (!writeDir(index, &dir)) return false;
+  }
+  return fatPut(from, 0);
+}
+//------------------------------------------------------------------------------
+bool RamVolume::planFormat(uint32_t totalBlocks, const RamWorkload* workload,
+                           RamFormatPlan* plan) {
+  RamDiskParams params;
+  uint32_t size = workload->fileSize;
+  uint32_t w = workload->writeSize;
+  uint32_t dirBlocks = (workload->fileCount + 15UL)/16;
+  uint8_t pct = workload->maxSlackPercent;
+  uint32_t maxSlack = size/100*pct + size%100*pct/100;
+  uint32_t best = 0;
+  bool found = false;
+  if (w == 0 || workload->fileCount == 0 || dirBlocks > 255) return false;
+  if (dirBlocks == 0) dirBlocks = 1;
+  for (uint8_t shift = 0; shift <= 6; shift++) {
+    uint8_t fatType;
+    uint32_t c = 512UL << shift;
+    uint32_t clusters = (size + c - 1) >> (9 + shift);
+    uint32_t slack = clusters*c - size;
+    if (slack > maxSlack) continue;
+    params.clusterSizeShift = shift;
+    if (totalBlocks < (dirBlocks + (1UL << shift) + 2)
+        || !formatGeometry((totalBlocks >> shift) << shift, dirBlocks,
+                           workload->options & RAM_FORMAT_FAT_BOOT,
+                           &params, &fatType)
+        || (uint32_t)workload->fileCount*clusters > params.clusterCount) {
+      continue;
+    }
+    // Each write or cluster boundary starts a data transaction.
+    uint32_t a = c;
+    uint32_t b = w;
+    while (b) {
+      uint32_t t = a % b;
+      a = b;
+      b = t;
+    }
+    uint32_t lcm = c/a*w;
+    uint32_t pieces = size ? (size - 1)/w + (size - 1)/c
+                             - (size - 1)/lcm + 1 : 0;
+    uint32_t metadataOps = 3*workload->fileCount/2 + 4;
+    if (clusters) {
+      metadataOps += 5*clusters - 3;
+      if (fatType == 12) metadataOps += 2*clusters - 1;
+    }
+    // Keep the smaller cluster if costs are equal.
+    if (found && (metadataOps + 2*pieces) >= best) continue;
+    best = metadataOps + 2*pieces;
+    found = true;
+    plan->blocksPerCluster = 1 << shift;
+    plan->dirBlocks = dirBlocks;
+    plan->fatType = fatType;
+    plan->clusterCount = params.clusterCount;
+    plan->slackBytes = workload->fileCount*slack;
+    plan->metadataOps = metadataOps;
+    plan->dataOps = 2*pieces;
+  }
+  return found;
+}
+//------------------------------------------------------------------------------
 void RamVolume::printInfo(Print* pr) {
   pr->println(F("\nVolume Info:"));
+  pr->print(F("FAT Type: "));
+  pr->println(fatType());
   pr->print(F("FAT Size: "));
   pr->println(fatSize());
   pr->print(F("Dir Start Block: "));
@@ -217,6 +1270,83 @@ void RamVolume::printInfo(Print* pr) {
   pr->println();
 }
 //------------------------------------------------------------------------------
+bool RamVolume::printLayout(Print* pr) {
+  RamLayoutStats stats;
+  uint8_t buf[64];
+  pr->println(F("\nLayout:"));
+  pr->println(F("Name          Clusters Extents"));
+  if (!layout(&stats, buf, sizeof(buf), pr)) return false;
+  pr->print(F("Files: "));
+  pr->println(stats.files);
+  pr->print(F("Fragmented Files: "));
+  pr->println(stats.fragmentedFiles);
+  pr->print(F("Max File Extents: "));
+  pr->println(stats.maxFileExtents);
+  pr->print(F("Average Extent Clusters: "));
+  pr->println(stats.extents ? (float)stats.fileClusters/stats.extents : 0, 2);
+  pr->print(F("Free Clusters: "));
+  pr->println(stats.freeClusters);
+  pr->print(F("Free Extents: "));
+  pr->println(stats.freeExtents);
+  pr->print(F("Largest Free Run: "));
+  pr->println(stats.largestFreeRun);
+  pr->println(F("Free Runs By Length:"));
+  for (uint8_t i = 0; i < RAM_LAYOUT_HIST_BUCKETS; i++) {
+    pr->print(1UL << i);
+    if (i == (RAM_LAYOUT_HIST_BUCKETS - 1)) {
+      pr->write('+');
+    } else if (i) {
+      pr->write('-');
+      pr->print((2UL << i) - 1);
+    }
+    pr->print(F(": "));
+    pr->println(stats.freeHist[i]);
+  }
+  pr->println();
+  return true;
+}
+//------------------------------------------------------------------------------
+// Convert a FAT boot sector written by format() to RamDiskParams.
+bool RamVolume::readBootSector(RamBaseDevice* dev, RamDiskParams* params) {
+  uint8_t bpb[offsetof(fat_boot_t, driveNumber)];
+  fat_boot_t* pb = reinterpret_cast<fat_boot_t*>(bpb);
+  uint8_t sig[2];
+  uint8_t shift = 0;
+  uint32_t totalBlocks;
+  uint32_t nc;
+  if (!dev->read(0, bpb, sizeof(bpb)) || !dev->read(510, sig, 2)) {
+    return false;
+  }
+  if (sig[0] != BOOTSIG0 || sig[1] != BOOTSIG1
+    || pb->bytesPerSector != 512
+    || pb->reservedSectorCount != FAT_START_BLOCK
+    || pb->fatCount != 1
+    || pb->sectorsPerFat16 == 0
+    || pb->rootDirEntryCount == 0
+    || (pb->rootDirEntryCount & 0XF)) {
+    return false;
+  }
+  for (uint8_t tmp = 1; pb->sectorsPerCluster != tmp; shift++, tmp <<= 1) {
+    if (shift == 6) return false;
+  }
+  params->clusterSizeShift = shift;
+  params->rootDirStartBlock = FAT_START_BLOCK + pb->sectorsPerFat16;
+  params->dataStartBlock = params->rootDirStartBlock
+                           + pb->rootDirEntryCount/16;
+  totalBlocks = pb->totalSectors16 ? pb->totalSectors16 : pb->totalSectors32;
+  if (totalBlocks <= params->dataStartBlock) return false;
+  nc = (totalBlocks - params->dataStartBlock) >> shift;
+  // FAT type is determined by cluster count.
+  m_fatType = nc < 4085 ? 12 : 16;
+  // The FAT must hold nc + 2 entries.
+  if ((m_fatType == 12 ? (3*(nc + 2) + 1)/2 : 2*(nc + 2))
+      > 512UL*pb->sectorsPerFat16) {
+    return false;
+  }
+  params->clusterCount = nc;
+  return true;
+}
+//------------------------------------------------------------------------------
 bool RamVolume::readDir(uint16_t index, dir_t* dir) {
   if (index >= m_rootDirEntryCount) {
     return false;
@@ -225,16 +1355,62 @@ bool RamVolume::readDir(uint16_t index, dir_t* dir) {
   return m_ramDev->read(dirAddress(index), dir, sizeof(dir_t));
 }
 //------------------------------------------------------------------------------
+bool RamVolume::reclaim(uint16_t budget) {
+#if RAM_DISK_PENDING_FREE_SLOTS
+  for (uint8_t i = 0; i < RAM_DISK_PENDING_FREE_SLOTS; i++) {
+    while (m_pendingFree[i] && budget) {
+      if (!freeCountChanged()) return false;
+      if (!freeCluster(m_pendingFree[i], &m_pendingFree[i])) return false;
+      budget--;
+    }
+  }
+#endif  // RAM_DISK_PENDING_FREE_SLOTS
+  return true;
+}
+//------------------------------------------------------------------------------
 bool RamVolume::remove(const char* fileName) {
   RamBaseFile file;
   if (!file.open(this, fileName, O_WRITE)) return false;
   return file.remove();
 }
 //------------------------------------------------------------------------------
+void RamVolume::setDirtyMap(uint8_t* map, bool dirty) {
+  m_dirtyMap = map;
+  if (map) memset(map, dirty ? 0XFF : 0, dirtyMapSize());
+}
+//------------------------------------------------------------------------------
+bool RamVolume::syncParams() {
+  if (!m_paramsDirty || !m_paramsPersist) return true;
+  fat_t info[2];
+  info[0] = m_freeCount;
+  info[1] = m_allocStartCluster + 1;
+  if (info[1] > (m_clusterCount + 1)) info[1] = 2;
+  if (!write(offsetof(RamDiskParams, freeCount), info, sizeof(info))) {
+    return false;
+  }
+  m_paramsDirty = false;
+  return true;
+}
+#if RAM_DISK_RESERVE_SLOTS
+//------------------------------------------------------------------------------
+// Assign an allocation window slot to a file open for write.  The window
+// is empty until the file allocates a cluster.
+uint8_t RamVolume::windowOpen() {
+  for (uint8_t i = 0; i < RAM_DISK_RESERVE_SLOTS; i++) {
+    if (m_windowEnd[i] == 0) {
+      // Cluster one is never allocated.
+      m_windowNext[i] = m_windowEnd[i] = 1;
+      return i;
+    }
+  }
+  return NO_WINDOW;
+}
+#endif  // RAM_DISK_RESERVE_SLOTS
+//------------------------------------------------------------------------------
 bool RamVolume::writeDir(uint16_t index, dir_t* dir) {
   if (index >= m_rootDirEntryCount) {
     return false;
   }
 //  uint32_t addr = (m_rootDirStartBlock << 9) + (index << 5);
-  return m_ramDev->write(dirAddress(index), dir, sizeof(dir_t));
+  return write(dirAddress(index), dir, sizeof(dir_t));
 }
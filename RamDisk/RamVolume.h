@@ -27,44 +27,274 @@
 #include <utility/FatStructs.h>
 #include <utility/FatApiConstants.h>
 #include <RamBaseDevice.h>
+#include <RamDiskConfig.h>
 //------------------------------------------------------------------------------
+#if RAM_DISK_USE_32_BIT_FAT
 /**
  * \typedef fat_t
  *
  * \brief Type for FAT entry
  */
-typedef uint16_t fat_t;
-//------------------------------------------------------------------------------
+typedef uint32_t fat_t;
 /** RamDiskParams version YYYYMMDD */
-const uint32_t RAM_DISK_PARAMS_VERSION = 20140427;
+const uint32_t RAM_DISK_PARAMS_VERSION = 20140615;
+/** RamDiskParams freeCount value if the count is not known. */
+const fat_t RAM_DISK_FREE_COUNT_UNKNOWN = 0XFFFFFFFF;
+/** Value written to mark the end of a cluster chain. */
+const fat_t RAM_DISK_EOC = FAT32EOC;
+/** Minimum value for end of a cluster chain. */
+const fat_t RAM_DISK_EOC_MIN = FAT32EOC_MIN;
+#else  // RAM_DISK_USE_32_BIT_FAT
+typedef uint16_t fat_t;
+const uint32_t RAM_DISK_PARAMS_VERSION = 20140601;
+/** RamDiskParams version without freeCount and nextFree.  Still mounted. */
+const uint32_t RAM_DISK_PARAMS_VERSION_20140427 = 20140427;
+const fat_t RAM_DISK_FREE_COUNT_UNKNOWN = 0XFFFF;
+const fat_t RAM_DISK_EOC = FAT16EOC;
+const fat_t RAM_DISK_EOC_MIN = FAT16EOC_MIN;
+#endif  // RAM_DISK_USE_32_BIT_FAT
 /** \class RamDiskParams
  * \brief RamDiskParams file-system parameters stored at location zero.
+ *
+ * Cluster counts and block numbers have the width of a FAT entry.
  */
 struct RamDiskParams {
            /** Version of the RamDiskParams structure. */
   uint32_t version;
            /** Number of data clusters in the volume. */
-  uint16_t clusterCount;
+  fat_t    clusterCount;
            /** Start of the directory in 512 byte blocks */
-  uint16_t dataStartBlock;
+  fat_t    dataStartBlock;
            /** Start of the data in 512 byte blocks */
-  uint16_t rootDirStartBlock;
+  fat_t    rootDirStartBlock;
            /** Shift that produces blocksPerCluster.
             *  blocksPerCluster = 1 << clusterSizeShift*/
   uint8_t  clusterSizeShift;
+           /** Free clusters at the last sync or RAM_DISK_FREE_COUNT_UNKNOWN.
+            *  Set to unknown before the first change after a sync. */
+  fat_t    freeCount;
+           /** Hint for the next free cluster at the last sync. */
+  fat_t    nextFree;
 }__attribute__((packed));
 //------------------------------------------------------------------------------
+/** \class RamDefragState
+ * \brief State of a RamVolume::defragment() pass.
+ */
+struct RamDefragState {
+           /** Fragment count when the pass started. */
+  uint32_t fragmentsBefore;
+           /** Fragment count when the pass completed. */
+  uint32_t fragmentsAfter;
+           /** Number of clusters moved to their final place. */
+  uint32_t movedCount;
+           /** Next cluster of the packed area. */
+  fat_t    target;
+           /** Cluster of the current file to be placed at target or zero. */
+  fat_t    cluster;
+           /** Cluster before cluster in the current file or zero. */
+  fat_t    prev;
+           /** Directory index of the current file. */
+  uint16_t dirIndex;
+           /** No cluster above freeHint is free. */
+  fat_t    freeHint;
+};
+/** \class RamCheckResult
+ * \brief Counts returned by RamVolume::check().
+ */
+struct RamCheckResult {
+           /** Free clusters, after repair if repair was requested. */
+  fat_t    freeClusters;
+           /** Links to a free cluster or a cluster outside the volume. */
+  uint32_t badLinks;
+           /** Clusters linked from more than one place. */
+  uint32_t crossLinks;
+           /** Files with a chain that does not match the file size. */
+  uint32_t sizeErrors;
+           /** Allocated chains not linked to a file. */
+  uint32_t lostChains;
+           /** Clusters in lost chains. */
+  uint32_t lostClusters;
+};
+/** Number of free run buckets in RamLayoutStats. */
+uint8_t const RAM_LAYOUT_HIST_BUCKETS = 8;
+/** \class RamLayoutStats
+ * \brief Counts returned by RamVolume::layoutStats().
+ */
+struct RamLayoutStats {
+           /** Files with data. */
+  uint16_t files;
+           /** Files with more than one extent. */
+  uint16_t fragmentedFiles;
+           /** Most extents in one file. */
+  uint32_t maxFileExtents;
+           /** Contiguous runs of clusters in all files. */
+  uint32_t extents;
+           /** Clusters in all files. */
+  uint32_t fileClusters;
+           /** Free clusters. */
+  fat_t    freeClusters;
+           /** Contiguous runs of free clusters. */
+  uint32_t freeExtents;
+           /** Longest run of free clusters. */
+  fat_t    largestFreeRun;
+           /** Free runs by length.  Bucket i counts runs of 2^i to
+            *  2^(i+1) - 1 clusters.  The last bucket counts all longer
+            *  runs. */
+  uint32_t freeHist[RAM_LAYOUT_HIST_BUCKETS];
+};
+/** \class RamWorkload
+ * \brief Expected use of a volume for RamVolume::formatForWorkload().
+ */
+struct RamWorkload {
+           /** Number of files. */
+  uint16_t fileCount;
+           /** Average file size in bytes. */
+  uint32_t fileSize;
+           /** Bytes in a typical write() call. */
+  uint16_t writeSize;
+           /** Limit for unused bytes in the last cluster of each file as
+            *  a percent of the file size. */
+  uint8_t  maxSlackPercent;
+           /** format() options. */
+  uint8_t  options;
+};
+/** \class RamFormatPlan
+ * \brief Geometry and predicted costs from RamVolume::planFormat().
+ *
+ * Operation counts are device transactions to create, write, close,
+ * open and read one file of the average size.
+ */
+struct RamFormatPlan {
+           /** Blocks in a cluster. */
+  uint8_t  blocksPerCluster;
+           /** Directory blocks. */
+  uint8_t  dirBlocks;
+           /** 12, 16 or 32. */
+  uint8_t  fatType;
+           /** Clusters in the volume. */
+  uint32_t clusterCount;
+           /** Unused bytes in the last cluster of all files. */
+  uint32_t slackBytes;
+           /** Predicted FAT and directory transactions. */
+  uint32_t metadataOps;
+           /** Predicted data transactions. */
+  uint32_t dataOps;
+};
+//------------------------------------------------------------------------------
+/** defragment() return value - more steps are required. */
+int8_t const RAM_DEFRAG_BUSY = 1;
+/** defragment() return value - all files are contiguous. */
+int8_t const RAM_DEFRAG_DONE = 0;
+/** defragment() return value - an I/O error occurred or no cluster is free. */
+int8_t const RAM_DEFRAG_ERROR = -1;
+//------------------------------------------------------------------------------
+/** ioClass() value - volume parameters or boot sector. */
+uint8_t const RAM_IO_PARAMS = 0;
+/** ioClass() value - file allocation table. */
+uint8_t const RAM_IO_FAT = 1;
+/** ioClass() value - root directory. */
+uint8_t const RAM_IO_DIR = 2;
+/** ioClass() value - file data. */
+uint8_t const RAM_IO_DATA = 3;
+/** Number of ioClass() values. */
+uint8_t const RAM_IO_CLASS_COUNT = 4;
+//------------------------------------------------------------------------------
+/** format() option - write a FAT boot sector instead of RamDiskParams. */
+uint8_t const RAM_FORMAT_FAT_BOOT = 0X01;
+/** format() option - zero the FAT and the first directory entry only. */
+uint8_t const RAM_FORMAT_QUICK = 0X02;
+//------------------------------------------------------------------------------
 /** \class RamVolume
  * \brief RamVolume Ram Disk FAT16 like volume.
  */
 class RamVolume {
  public:
+  /** Create a volume with dirty tracking disabled. */
+  RamVolume() : m_dirtyMap(0) {}
+
   /** \return The number of 512 byte blocks in a cluster */
   uint8_t blocksPerCluster() {return 1 << m_clusterSizeShift;}
 
+  /**
+   * Check the FAT and directory for errors and optionally repair them.
+   *
+   * The FAT is read once in bursts into \a buf and two bits for each
+   * cluster, allocated and referenced, are kept in a map at the start of
+   * \a buf.  Each file chain is then walked through the burst buffer and
+   * its clusters are marked as reached.  Allocated clusters that are not
+   * reached from a directory entry are lost.
+   *
+   * Errors found are:
+   *
+   * Bad links - a FAT entry or directory entry that links to a cluster
+   * outside the volume or to a free cluster.  Repair ends the chain.
+   *
+   * Cross-links - a cluster linked from two places.  Repair ends the
+   * chain with the higher cluster number or, for a directory entry,
+   * removes the file's data.
+   *
+   * Size errors - a chain that is too short or too long for the file size,
+   * for example after a reset before RamBaseFile::sync().  Repair sets the
+   * size of a short file to its chain and frees the extra clusters of a
+   * long file.
+   *
+   * Lost chains - allocated clusters not linked to a file, including
+   * chains that loop.  Chains waiting for reclaim() are reported as lost.
+   * Repair frees them.
+   *
+   * No files may be open.
+   *
+   * \param[in] repair Fix errors if true.
+   *
+   * \param[in] buf Buffer for the map and FAT bursts.  Must be at least
+   *            checkMapSize() + 4 bytes.  Larger buffers make fewer reads.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \param[out] result Counts of free clusters and errors.
+   *
+   * \return true if the check completed or false for failure.
+   */
+  bool check(bool repair, uint8_t* buf, size_t size, RamCheckResult* result);
+
+  /** \return The number of bytes check() uses for its cluster map. */
+  uint32_t checkMapSize() {return ((uint32_t)m_clusterCount + 5)/4;}
+
   /** Set the current working volume to this volume. */
   void chvol() {RamVolume::m_curVol = this;}
 
+  /**
+   * Copy a file from one volume to another.
+   *
+   * The copy is written to a new contiguous chain while an existing
+   * destination file keeps its data.  Data is moved from device to device
+   * in chunks as large as \a buf.  A chunk may span clusters where the
+   * source file is contiguous.  The new chain and size replace the old in
+   * one directory write after the copy and the old chain is then freed.
+   * A reset during the copy leaves the old file and a lost chain that
+   * check() can free.
+   *
+   * If no contiguous run of clusters is free, an existing destination is
+   * truncated and the copy uses RamBaseFile read() and write().  A reset
+   * during this copy leaves part of the file.
+   *
+   * The file must not be open on either volume.  Dates are copied.
+   *
+   * \param[in] srcVol Volume with the file.
+   *
+   * \param[in] name Name of the file.
+   *
+   * \param[in] dstVol Volume for the copy.  May not be \a srcVol.
+   *
+   * \param[in] buf Buffer for the copy.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \return true for success or false for failure.
+   */
+  static bool copyFile(RamVolume* srcVol, const char* name,
+                       RamVolume* dstVol, uint8_t* buf, size_t size);
+
   /** \return The count of clusters in the volume. */
   fat_t clusterCount() {return m_clusterCount;}
 
@@ -75,13 +305,119 @@ class RamVolume {
   uint8_t clusterSizeShift() {return m_clusterSizeShift;}
 
   /** \return Data start block number. */
-  uint16_t dataStartBlock() {return m_dataStartBlock;}
+  uint32_t dataStartBlock() {return m_dataStartBlock;}
+
+  /**
+   * Start a defragment() pass.
+   *
+   * \param[out] state State for the pass.  The fragment count of the volume
+   *             is stored in fragmentsBefore.
+   *
+   * \return true for success or false for failure.
+   */
+  bool defragBegin(RamDefragState* state);
+
+  /**
+   * Do one bounded step of a defragment pass.
+   *
+   * Files are packed in directory order at the start of the data area so
+   * each file is one contiguous run of clusters.  A step moves at most one
+   * cluster.  If the place for a cluster is in use, the cluster there is
+   * first moved to the highest free cluster.
+   *
+   * The FAT and directory are scanned in bursts through \a buf.  The search
+   * for the link to a cluster in use is skipped if the cluster follows the
+   * current cluster.  The search for a free cluster resumes below the last
+   * one found, so a pass reads the FAT for free clusters about once.
+   *
+   * A cluster is copied to a free cluster and linked into its chain before
+   * the old cluster is freed, so a reset during a step loses at most one
+   * cluster and never file data.
+   *
+   * No files may be open and the volume must not be changed until the pass
+   * is done.  At least one cluster must be free.
+   *
+   * \param[in,out] state State initialized by defragBegin().
+   *
+   * \param[in] buf Buffer for the cluster copy and scans.  Must be at least
+   *            32 bytes.  Larger buffers make fewer reads.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \return RAM_DEFRAG_BUSY if more steps are required, RAM_DEFRAG_DONE if
+   *         the pass is complete or RAM_DEFRAG_ERROR for failure.
+   */
+  int8_t defragment(RamDefragState* state, uint8_t* buf, size_t size);
+
+  /** \return The raw RAM device for the volume. */
+  RamBaseDevice* device() {return m_ramDev;}
+
+  /** Mark a region clean.
+   *
+   * \param[in] region Index of the region.
+   */
+  void dirtyClear(uint32_t region) {
+    m_dirtyMap[region >> 3] &= ~(1 << (region & 7));
+  }
+
+  /** \return The dirty map or null if tracking is disabled. */
+  uint8_t* dirtyMap() {return m_dirtyMap;}
+
+  /** \return The number of bytes required for a dirty map. */
+  uint32_t dirtyMapSize() {return (dirtyRegionCount() + 7)/8;}
+
+  /** \return true if a region has been written since it was marked clean.
+   *
+   * \param[in] region Index of the region.
+   */
+  bool dirtyRegion(uint32_t region) {
+    return m_dirtyMap[region >> 3] & (1 << (region & 7));
+  }
+
+  /** \param[in] region Index of a region.
+   * \return The device address of the region.
+   */
+  uint32_t dirtyRegionAddress(uint32_t region) {
+    if (region < m_dataStartBlock) return (uint32_t)region << 9;
+    return clusterAddress(region - m_dataStartBlock + 2);
+  }
+
+  /** \return The number of regions tracked by the dirty map.  Each block
+   * before the data area is a region and each cluster is a region.
+   */
+  uint32_t dirtyRegionCount() {
+    return m_dataStartBlock + (uint32_t)m_clusterCount;
+  }
+
+  /** \param[in] region Index of a region.
+   * \return The size of the region in bytes.
+   */
+  uint16_t dirtyRegionSize(uint32_t region) {
+    return region < m_dataStartBlock ? 512 : clusterSizeBytes();
+  }
+
+  /** \return FAT entry size in bits, 12, 16 or 32. */
+  uint8_t fatType() {return m_fatType;}
 
   /** \return the Size of the FAT in blocks. */
-  uint16_t fatSize() {return m_rootDirStartBlock - FAT_START_BLOCK;}
+  uint32_t fatSize() {return m_rootDirStartBlock - FAT_START_BLOCK;}
 
-  /** \return The number of free clusters in the file-system. */
-  uint16_t freeClusterCount();
+  /** \return The number of free clusters in the file-system.
+   *
+   * The count is kept in RAM after the first call and, for RamDiskParams
+   * volumes, saved on the device by syncParams().
+   */
+  fat_t freeClusterCount();
+
+  /**
+   * Count the contiguous runs of clusters in all files.
+   *
+   * A volume with no fragmented files has one fragment for each file that
+   * has data.
+   *
+   * \return The fragment count or zero if an error occurs.
+   */
+  uint32_t fragmentCount();
 
   /**
    * Format the RamDisk volume.
@@ -97,18 +433,81 @@ class RamVolume {
    * \param[in]  blocksPerCluster number of blocks in a cluster.
    *             blocksPerCluster must be a power of two less than 128.
    *
+   * \param[in] options RAM_FORMAT_FAT_BOOT writes a FAT boot sector in
+   *            block zero so a block copy of the volume can be mounted
+   *            as a FAT12 or FAT16 volume by SdFat or a PC.  The FAT is
+   *            FAT12 if there are fewer than 4085 clusters.  SdFat
+   *            requires FAT12_SUPPORT to mount a FAT12 volume.  A boot
+   *            sector volume has 12 or 16-bit FAT entries even if
+   *            RAM_DISK_USE_32_BIT_FAT is nonzero.
+   *
+   *            RAM_FORMAT_QUICK zeros the FAT and the first directory
+   *            entry but not the rest of the directory.  Like FAT, the
+   *            first free entry marks the end of the directory and
+   *            RamBaseFile zeros the next entry when a file is created
+   *            at the end.
+   *
    * \return true for success or false for failure.
    */
   bool format(RamBaseDevice* dev, uint32_t totalBlocks = 0,
-                     uint8_t dirBlocks = 4, uint8_t blocksPerCluster = 1);
+                     uint8_t dirBlocks = 4, uint8_t blocksPerCluster = 1,
+                     uint8_t options = 0);
+
   /**
-   * Initialize the RamDisk volume.
+   * Format the volume with the geometry from planFormat().
+   *
+   * \param[in] dev The raw RAM device.  The volume uses all of the device.
+   *
+   * \param[in] workload Expected files and writes.
+   *
+   * \param[out] plan Geometry and predicted costs.  May be null.
+   *
+   * \return true for success or false for failure.
+   */
+  bool formatForWorkload(RamBaseDevice* dev, const RamWorkload* workload,
+                         RamFormatPlan* plan = 0);
+
+  /**
+   * Initialize the RamDisk volume.  Volumes with RamDiskParams or a FAT
+   * boot sector written by format() are accepted.
+   *
    * \param[in] dev the raw RAM device.
    *
    * \return true for success or false for failure.
    */
   bool init(RamBaseDevice* dev);
 
+  /** Find the volume area that contains a device address.  All volume
+   * and file I/O can be classified by address since the root directory
+   * is the only directory.
+   *
+   * \param[in] address Device address.
+   *
+   * \return RAM_IO_PARAMS, RAM_IO_FAT, RAM_IO_DIR or RAM_IO_DATA.
+   */
+  uint8_t ioClass(uint32_t address) {
+    if (address < 512*FAT_START_BLOCK) return RAM_IO_PARAMS;
+    if (address < 512*m_rootDirStartBlock) return RAM_IO_FAT;
+    return address < 512*m_dataStartBlock ? RAM_IO_DIR : RAM_IO_DATA;
+  }
+
+  /**
+   * Measure fragmentation of files and free space.
+   *
+   * The FAT is read in bursts through \a buf.  Chains waiting for
+   * reclaim() are neither free nor in a file.
+   *
+   * \param[out] stats File extent counts and free run lengths.
+   *
+   * \param[in] buf Buffer for FAT bursts.  Must be at least 4 bytes.
+   *            Larger buffers make fewer reads.
+   *
+   * \param[in] size Size of \a buf in bytes.
+   *
+   * \return true for success or false for failure.
+   */
+  bool layoutStats(RamLayoutStats* stats, uint8_t* buf, size_t size);
+
   /** List directory contents.
    *
    * \param[in] pr Print stream that list will be written to.
@@ -121,12 +520,52 @@ class RamVolume {
    */
   void ls(Print* pr, uint8_t flags = 0);
 
+  /**
+   * Choose the cluster and directory size for a workload without
+   * formatting a device.
+   *
+   * The directory has room for workload->fileCount files.  Of the cluster
+   * sizes that keep the unused bytes in the last cluster of each file
+   * within workload->maxSlackPercent, and the files within the volume, the
+   * size with the fewest predicted transactions is chosen.  Larger clusters
+   * need fewer FAT transactions and split fewer writes.
+   *
+   * Each cluster after the first costs a FAT read for the end of the file,
+   * a read to find a free cluster, a write to mark it and a write to link
+   * it.  Each cluster read after the first costs a FAT read.  FAT12 entries
+   * share bytes so each FAT write also reads.  With RAM_FORMAT_FAT_BOOT in
+   * workload->options the FAT is FAT12 below 4085 clusters.  Creating a
+   * file searches all entries and opening it searches half on average.
+   * Files are assumed to be written sequentially.
+   *
+   * \param[in] totalBlocks Number of 512 byte blocks in the volume.
+   *
+   * \param[in] workload Expected files and writes.
+   *
+   * \param[out] plan Geometry and predicted costs.
+   *
+   * \return true for success or false if no geometry fits.
+   */
+  static bool planFormat(uint32_t totalBlocks, const RamWorkload* workload,
+                         RamFormatPlan* plan);
+
   /** Print volume information.
    *
    * \param[in] pr Print stream that information will be written to.
    */
   void printInfo(Print* pr);
 
+  /**
+   * Print clusters and extents for each file followed by the counts
+   * from layoutStats().  Use the counts to decide when to defragment or
+   * format with a different blocksPerCluster.
+   *
+   * \param[in] pr Print stream for the report.
+   *
+   * \return true for success or false for failure.
+   */
+  bool printLayout(Print* pr);
+
   /**
    * Remove a file.
    *
@@ -145,53 +584,199 @@ class RamVolume {
    */
   bool remove(const char* fileName);
 
+  /**
+   * Free clusters of chains detached by RamBaseFile::remove() and
+   * RamBaseFile::truncate().
+   *
+   * Each freed cluster costs one FAT read and one FAT write.  Chains not
+   * freed before a reset are not recorded on the device so their clusters
+   * stay allocated but unused.
+   *
+   * \param[in] budget Maximum number of clusters to free.
+   *
+   * \return true for success or false for failure.
+   */
+  bool reclaim(uint16_t budget);
+
+  /** \return true if removed chains are waiting for reclaim(). */
+  bool reclaimPending() {
+#if RAM_DISK_PENDING_FREE_SLOTS
+    for (uint8_t i = 0; i < RAM_DISK_PENDING_FREE_SLOTS; i++) {
+      if (m_pendingFree[i]) return true;
+    }
+#endif  // RAM_DISK_PENDING_FREE_SLOTS
+    return false;
+  }
+
   /** \return The number of entries in the root directory. */
   uint16_t rootDirEntryCount() {return m_rootDirEntryCount;}
 
   /** \return The root directory start block number. */
-  uint16_t rootDirStartBlock() {return m_rootDirStartBlock;}
+  uint32_t rootDirStartBlock() {return m_rootDirStartBlock;}
+
+  /**
+   * Enable tracking of written regions.
+   *
+   * Each block before the data area and each data cluster is a region.  A
+   * region's bit is set when any byte of the region is written through the
+   * volume.  Writes made directly to the device are not tracked.
+   *
+   * Call after init().  The map stays in use until setDirtyMap(0) is called.
+   *
+   * \param[in] map Array of at least dirtyMapSize() bytes or null to
+   *            disable tracking.
+   *
+   * \param[in] dirty Initial state for all regions.  Use true if the volume
+   *            has not been saved.
+   */
+  void setDirtyMap(uint8_t* map, bool dirty = true);
+
+  /**
+   * Save the free cluster count and next free cluster hint on the device.
+   *
+   * Called by RamBaseFile::sync() and RamBaseFile::remove().  Nothing is
+   * written if the FAT has not changed since the last call or the volume has
+   * a FAT boot sector or an old RamDiskParams version.
+   *
+   * \return true for success or false for failure.
+   */
+  bool syncParams();
 
  private:
   // Allow RamBaseFile access to RamVolume private data.
   friend class RamBaseFile;
 //------------------------------------------------------------------------------
   static const uint32_t FAT_START_BLOCK = 1;      // start of FAT
-  bool allocCluster(fat_t* cluster);
+  static const uint8_t NO_WINDOW = 0XFF;          // file has no window
+  static const uint8_t CHECK_ALLOCATED = 1;       // check() map bits
+  static const uint8_t CHECK_REFERENCED = 2;
+  // FAT bytes read in one burst.
+  struct FatBurst {
+    uint8_t* buf;      // buffer for FAT bytes
+    size_t size;       // size of buf
+    size_t count;      // valid bytes in buf
+    uint32_t address;  // device address of buf[0]
+  };
+  bool allocCluster(fat_t* cluster, uint8_t slot = NO_WINDOW);
+  bool allocContiguous(fat_t count, fat_t* first, uint8_t* buf, size_t size);
   uint32_t clusterAddress(fat_t cluster) {
     uint32_t lba = m_dataStartBlock
                    + ((uint32_t)(cluster - 2) << m_clusterSizeShift);
     return lba << 9;
   }
+  uint8_t checkBits(uint8_t* map, fat_t cluster) {
+    return (map[cluster >> 2] >> (2*(cluster & 3))) & 3;
+  }
+  // Set a bit in the map and return its old value.
+  bool checkMark(uint8_t* map, fat_t cluster, uint8_t bit) {
+    uint8_t mask = bit << (2*(cluster & 3));
+    bool old = map[cluster >> 2] & mask;
+    map[cluster >> 2] |= mask;
+    return old;
+  }
+  // Clear a bit in the map.
+  void checkClear(uint8_t* map, fat_t cluster, uint8_t bit) {
+    map[cluster >> 2] &= ~(bit << (2*(cluster & 3)));
+  }
   uint16_t clusterOffsetMask() {return m_clusterOffsetMask;}
+  fat_t dirCluster(const dir_t* dir) {
+    fat_t cluster = dir->firstClusterLow;
+    if (m_fatType == 32) cluster |= (uint32_t)dir->firstClusterHigh << 16;
+    return cluster;
+  }
   uint32_t dirAddress(uint16_t index) {
     return  ((uint32_t)m_rootDirStartBlock << 9) + (index << 5);
   }
   uint32_t fatAddress(fat_t cluster) {
-    return 512*FAT_START_BLOCK + (cluster << 1);
+    uint32_t c = cluster;
+    if (m_fatType == 12) return 512*FAT_START_BLOCK + c + (c >> 1);
+    return 512*FAT_START_BLOCK + (c << (m_fatType == 16 ? 1 : 2));
   }
+  fat_t fatDecode(fat_t cluster, const uint8_t* entry);
+  static bool formatGeometry(uint32_t totalBlocks, uint8_t dirBlocks,
+                             bool fatBoot, RamDiskParams* params,
+                             uint8_t* fatType);
+  uint8_t fatEntryBytes() {return m_fatType == 12 ? 2 : m_fatType/8;}
   bool fatGet(fat_t cluster, fat_t* value);
+  bool fatGet(FatBurst* fb, fat_t cluster, fat_t* value);
   bool fatPut(fat_t cluster, fat_t value);
   bool freeChain(fat_t cluster);
+  bool freeCluster(fat_t cluster, fat_t* next);
+  bool freeLater(fat_t cluster);
+  bool freeCountChanged();
+  bool findFree(fat_t* cluster, uint8_t slot);
+  bool findParent(fat_t cluster, fat_t* parent, uint16_t* index,
+                  uint8_t* buf, size_t size);
   bool read(uint32_t address, void *buf, size_t nbyte) {
     return m_ramDev->read(address, buf, nbyte);
   }
-  bool isEOC(fat_t cluster) {return cluster >= 0XFFF8;}
+  bool isEOC(fat_t cluster) {return cluster >= RAM_DISK_EOC_MIN;}
+  bool layout(RamLayoutStats* stats, uint8_t* buf, size_t size, Print* pr);
+  void markDirty(uint32_t address, size_t nbyte);
+  bool moveCluster(fat_t from, fat_t to, fat_t parent, uint16_t index,
+                   uint8_t* buf, size_t size);
+  bool readBootSector(RamBaseDevice* dev, RamDiskParams* params);
   bool readDir(uint16_t index, dir_t *dir);
+  // All volume writes go through here so they can be tracked.
   bool write(uint32_t address, const void *buf, size_t nbyte) {
+    if (m_dirtyMap) markDirty(address, nbyte);
     return m_ramDev->write(address, buf, nbyte);
   }
+  void setDirCluster(dir_t* dir, fat_t cluster) {
+    dir->firstClusterLow = cluster & 0XFFFF;
+    dir->firstClusterHigh = (uint32_t)cluster >> 16;
+  }
+#if RAM_DISK_RESERVE_SLOTS
+  // Return true if cluster is in the window of a slot other than slot.
+  bool windowed(fat_t cluster, uint8_t slot) {
+    for (uint8_t i = 0; i < RAM_DISK_RESERVE_SLOTS; i++) {
+      if (i != slot && m_windowNext[i] <= cluster
+        && cluster < m_windowEnd[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+  void windowClose(uint8_t slot) {
+    if (slot < RAM_DISK_RESERVE_SLOTS) {
+      // Give the unused tail of the window back to the allocator.
+      if ((m_allocStartCluster + 1) == m_windowEnd[slot]) {
+        m_allocStartCluster = m_windowNext[slot] - 1;
+      }
+      m_windowNext[slot] = m_windowEnd[slot] = 0;
+    }
+  }
+  uint8_t windowOpen();
+#else  // RAM_DISK_RESERVE_SLOTS
+  bool windowed(fat_t cluster, uint8_t slot) {return false;}
+  void windowClose(uint8_t slot) {}
+  uint8_t windowOpen() {return NO_WINDOW;}
+#endif  // RAM_DISK_RESERVE_SLOTS
   bool writeDir(uint16_t index, dir_t *dir);
   static RamVolume* m_curVol;
   //----------------------------------------------------------------------------
   // Volume info
-  uint16_t m_allocStartCluster;  // place to start free cluster search
-  uint16_t m_dataStartBlock;     // start of data clusters
-  uint16_t m_rootDirStartBlock;  // start of root dir
+  fat_t    m_allocStartCluster;  // place to start free cluster search
+  fat_t    m_freeCount;          // free clusters or unknown
+  bool     m_paramsDirty;        // device freeCount is unknown
+  bool     m_paramsPersist;      // freeCount and nextFree are on device
+  uint32_t m_dataStartBlock;     // start of data clusters
+  uint32_t m_rootDirStartBlock;  // start of root dir
   bool     m_volumeValid;        // true if volume has been initialized
   uint8_t  m_clusterSizeShift;   // Shift to multiply by m_blocksPerCluster
+  uint8_t  m_fatType;            // 12, 16 or 32
   uint16_t m_clusterOffsetMask;  // Mask to determine offset in cluster
   uint16_t m_rootDirEntryCount;  // Entries in directory
   fat_t    m_clusterCount;       // total clusters in volume
   RamBaseDevice* m_ramDev;       // Raw RAM driver.
+  uint8_t* m_dirtyMap;           // Dirty region bits or null.
+#if RAM_DISK_PENDING_FREE_SLOTS
+  fat_t m_pendingFree[RAM_DISK_PENDING_FREE_SLOTS];  // chains to be freed
+#endif  // RAM_DISK_PENDING_FREE_SLOTS
+#if RAM_DISK_RESERVE_SLOTS
+  // Allocation windows.  A free slot has m_windowEnd zero.
+  fat_t m_windowNext[RAM_DISK_RESERVE_SLOTS];  // next cluster in window
+  fat_t m_windowEnd[RAM_DISK_RESERVE_SLOTS];   // end of window
+#endif  // RAM_DISK_RESERVE_SLOTS
 };
 #endif  // RamVolume_h
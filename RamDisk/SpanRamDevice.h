@@ -0,0 +1,172 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef SpanRamDevice_h
+#define SpanRamDevice_h
+/**
+ * \file
+ * SpanRamDevice class
+ */
+#include <RamBaseDevice.h>
+//------------------------------------------------------------------------------
+/**
+ * \class SpanRamDevice
+ * \brief Concatenate devices of different types into one device.
+ *
+ * Members are placed in the order given to begin().  The address space
+ * is divided into regions whose size is the largest power of two that
+ * divides the size of every member.  A table maps each region to its
+ * member so an address is routed with a shift and a table lookup.
+ *
+ * Transfers that cross a member boundary are split between members.
+ *
+ * \tparam MaxDevices Maximum number of members.
+ * \tparam MaxRegions Maximum number of entries in the region table.
+ */
+template<uint8_t MaxDevices, uint8_t MaxRegions = 32>
+class SpanRamDevice : public RamBaseDevice {
+ public:
+  /** Create a device.  Calls fail until begin() succeeds. */
+  SpanRamDevice() : m_count(0) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Initialize the device.
+   *
+   * \param[in] dev Array of initialized member devices.
+   *
+   * \param[in] count Number of members in \a dev.
+   *
+   * \return true for success or false for failure.  begin() fails if
+   * the region table is too small for the member sizes.
+   */
+  bool begin(RamBaseDevice** dev, uint8_t count) {
+    uint32_t sizes = 0;
+    uint32_t blocks = 0;
+    m_count = 0;
+    if (count == 0 || count > MaxDevices) return false;
+    for (uint8_t i = 0; i < count; i++) {
+      uint32_t n = dev[i]->sizeBlocks();
+      if (n == 0) return false;
+      m_dev[i] = dev[i];
+      m_base[i] = blocks << 9;
+      sizes |= n;
+      blocks += n;
+    }
+    m_base[count] = blocks << 9;
+    // Region size is the lowest bit set in any member size.
+    for (m_shift = 9; !(sizes & 1); m_shift++) sizes >>= 1;
+    if ((blocks >> (m_shift - 9)) > MaxRegions) return false;
+    for (uint8_t i = 0, r = 0; i < count; i++) {
+      while (((uint32_t)r << m_shift) < m_base[i + 1]) m_region[r++] = i;
+    }
+    m_count = count;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Fill a region of the device.
+   *
+   * \param[in] address Start of the region.
+   *
+   * \param[in] value Value stored in each byte.
+   *
+   * \param[in] length Number of bytes in the region.
+   *
+   * \return true for success or false for failure.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    while (length) {
+      uint8_t i;
+      uint32_t n = route(address, length, &i);
+      if (!n || !m_dev[i]->fill(address - m_base[i], value, n)) return false;
+      address += n;
+      length -= n;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Read data from the device.
+   *
+   * \param[in] address Location to be read.
+   *
+   * \param[out] buf Pointer to the location that will receive the data.
+   *
+   * \param[in] nbyte Number of bytes to read.
+   *
+   * \return true for success or false for failure.
+   */
+  bool read(uint32_t address, void *buf, size_t nbyte) {
+    uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+    while (nbyte) {
+      uint8_t i;
+      size_t n = route(address, nbyte, &i);
+      if (!n || !m_dev[i]->read(address - m_base[i], dst, n)) return false;
+      address += n;
+      dst += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Total number of 512 byte blocks in all members. */
+  uint32_t sizeBlocks() {return m_count ? m_base[m_count] >> 9 : 0;}
+  //----------------------------------------------------------------------------
+  /**
+   * Write data to the device.
+   *
+   * \param[in] address Location to be written.
+   *
+   * \param[in] buf Pointer to the location of the data to be written.
+   *
+   * \param[in] nbyte Number of bytes to write.
+   *
+   * \return true for success or false for failure.
+   */
+  bool write(uint32_t address, const void *buf, size_t nbyte) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
+    while (nbyte) {
+      uint8_t i;
+      size_t n = route(address, nbyte, &i);
+      if (!n || !m_dev[i]->write(address - m_base[i], src, n)) return false;
+      address += n;
+      src += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+
+ private:
+  // Find the member for address.  Return bytes to the end of the member
+  // or zero if address is past the end of the device.
+  uint32_t route(uint32_t address, uint32_t nbyte, uint8_t* dev) {
+    if (!m_count || address >= m_base[m_count]) return 0;
+    uint8_t i = m_region[address >> m_shift];
+    uint32_t n = m_base[i + 1] - address;
+    *dev = i;
+    return n < nbyte ? n : nbyte;
+  }
+
+  uint8_t m_count;                     // number of members
+  uint8_t m_shift;                     // log2 of region size
+  RamBaseDevice* m_dev[MaxDevices];    // members
+  uint32_t m_base[MaxDevices + 1];     // start address of each member
+  uint8_t m_region[MaxRegions];        // member index for each region
+};
+#endif  // SpanRamDevice_h
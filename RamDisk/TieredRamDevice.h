@@ -0,0 +1,241 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef TieredRamDevice_h
+#define TieredRamDevice_h
+/**
+ * \file
+ * TieredRamDevice class
+ */
+#include <RamBaseDevice.h>
+//------------------------------------------------------------------------------
+/**
+ * \class TieredRamDevice
+ * \brief Fast volatile hot tier over a slow persistent cold tier.
+ *
+ * The device has the size of the cold device, for example an MB85RS2MT
+ * FRAM.  Writes go to 512 byte blocks in the hot device, for example a
+ * 23LCV1024 SRAM, and are copied to the cold device by migrate() or
+ * flush().  Reads of a block in the hot tier come from the hot device,
+ * other reads go directly to the cold device.
+ *
+ * A partial write of a block that is not in the hot tier first copies the
+ * block from the cold device.  If all hot blocks are dirty the least
+ * recently written block is migrated before the write.
+ *
+ * Data in the hot tier is lost at power down unless flush() has been
+ * called.  Each slot uses seven bytes of Arduino SRAM.
+ *
+ * \tparam Slots Number of 512 byte blocks in the hot tier.
+ */
+template<uint16_t Slots>
+class TieredRamDevice : public RamBaseDevice {
+ public:
+  /** Create a device.  Calls fail until begin() succeeds. */
+  TieredRamDevice() : m_cold(0) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Initialize the device with an empty hot tier.
+   *
+   * \param[in] hot Fast device for the hot tier.
+   *
+   * \param[in] cold Persistent device that sets the size of this device.
+   *
+   * \param[in] hotAddress Start of a region on \a hot with room for
+   *            Slots blocks.
+   *
+   * \return true for success or false for failure.
+   */
+  bool begin(RamBaseDevice* hot, RamBaseDevice* cold,
+             uint32_t hotAddress = 0) {
+    m_cold = 0;
+    if (hot->sizeBlocks() < ((hotAddress + 511) >> 9) + Slots) return false;
+    m_hot = hot;
+    m_hotAddress = hotAddress;
+    m_clock = 0;
+    for (uint16_t i = 0; i < Slots; i++) {
+      m_block[i] = EMPTY;
+      m_dirty[i] = false;
+    }
+    m_cold = cold;
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of hot blocks not yet copied to the cold tier. */
+  uint16_t dirtyCount() {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < Slots; i++) {
+      if (m_dirty[i]) n++;
+    }
+    return n;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Copy all dirty hot blocks to the cold tier.
+   *
+   * \return true for success or false for failure.
+   */
+  bool flush() {
+    while (dirtyCount()) {
+      if (!migrate(Slots)) return false;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Copy the least recently written dirty blocks to the cold tier.
+   * Call from loop() when the bus is idle.  Blocks stay in the hot tier.
+   *
+   * \param[in] maxBlocks Maximum number of blocks to copy.
+   *
+   * \return true for success or false for failure.
+   */
+  bool migrate(uint16_t maxBlocks = 1) {
+    if (!m_cold) return false;
+    while (maxBlocks--) {
+      uint16_t i = oldest(true);
+      if (i == Slots) break;
+      if (!copy(m_cold, m_block[i] << 9, m_hot, slotAddress(i))) return false;
+      m_dirty[i] = false;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Read data from the device.
+   *
+   * \param[in] address Location to be read.
+   *
+   * \param[out] buf Pointer to the location that will receive the data.
+   *
+   * \param[in] nbyte Number of bytes to read.
+   *
+   * \return true for success or false for failure.
+   */
+  bool read(uint32_t address, void *buf, size_t nbyte) {
+    uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+    if (!m_cold) return false;
+    while (nbyte) {
+      uint16_t offset = address & 511;
+      size_t n = 512U - offset < nbyte ? 512U - offset : nbyte;
+      uint16_t i = find(address >> 9);
+      bool rtn = i < Slots ? m_hot->read(slotAddress(i) + offset, dst, n)
+                           : m_cold->read(address, dst, n);
+      if (!rtn) return false;
+      address += n;
+      dst += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Total number of 512 byte blocks in the cold device. */
+  uint32_t sizeBlocks() {return m_cold ? m_cold->sizeBlocks() : 0;}
+  //----------------------------------------------------------------------------
+  /**
+   * Write data to the hot tier.
+   *
+   * \param[in] address Location to be written.
+   *
+   * \param[in] buf Pointer to the location of the data to be written.
+   *
+   * \param[in] nbyte Number of bytes to write.
+   *
+   * \return true for success or false for failure.
+   */
+  bool write(uint32_t address, const void *buf, size_t nbyte) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
+    if (!m_cold) return false;
+    while (nbyte) {
+      uint16_t offset = address & 511;
+      size_t n = 512U - offset < nbyte ? 512U - offset : nbyte;
+      uint16_t i = find(address >> 9);
+      if (i == Slots) {
+        i = load(address >> 9, n < 512);
+        if (i == Slots) return false;
+      }
+      if (!m_hot->write(slotAddress(i) + offset, src, n)) return false;
+      m_dirty[i] = true;
+      if (m_clock == 0XFFFF) {
+        // Halve the stamps so the clock never wraps.  Order is kept.
+        for (uint16_t k = 0; k < Slots; k++) m_stamp[k] >>= 1;
+        m_clock >>= 1;
+      }
+      m_stamp[i] = ++m_clock;
+      address += n;
+      src += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+
+ private:
+  static const uint32_t EMPTY = 0XFFFFFFFF;
+  // Copy one block between devices with a small stack buffer.
+  static bool copy(RamBaseDevice* dst, uint32_t dstAddress,
+                   RamBaseDevice* src, uint32_t srcAddress) {
+    uint8_t tmp[32];
+    for (uint16_t k = 0; k < 512; k += sizeof(tmp)) {
+      if (!src->read(srcAddress + k, tmp, sizeof(tmp))) return false;
+      if (!dst->write(dstAddress + k, tmp, sizeof(tmp))) return false;
+    }
+    return true;
+  }
+  uint16_t find(uint32_t block) {
+    for (uint16_t i = 0; i < Slots; i++) {
+      if (m_block[i] == block) return i;
+    }
+    return Slots;
+  }
+  // Get a slot for block.  Copy the block from the cold tier if fill.
+  uint16_t load(uint32_t block, bool fill) {
+    uint16_t i = find(EMPTY);
+    if (i == Slots) i = oldest(false);
+    if (i == Slots) {
+      // All blocks are dirty.
+      if (!migrate(1)) return Slots;
+      i = oldest(false);
+    }
+    m_block[i] = EMPTY;
+    if (fill && !copy(m_hot, slotAddress(i), m_cold, block << 9)) return Slots;
+    m_block[i] = block;
+    return i;
+  }
+  // Least recently written slot that is dirty or clean.
+  uint16_t oldest(bool dirty) {
+    uint16_t r = Slots;
+    for (uint16_t i = 0; i < Slots; i++) {
+      if (m_block[i] == EMPTY || m_dirty[i] != dirty) continue;
+      if (r == Slots || m_stamp[i] < m_stamp[r]) r = i;
+    }
+    return r;
+  }
+  uint32_t slotAddress(uint16_t i) {
+    return ((m_hotAddress + 511) & ~511UL) + 512UL*i;
+  }
+
+  RamBaseDevice* m_hot;    // hot tier device
+  RamBaseDevice* m_cold;   // cold tier device
+  uint32_t m_hotAddress;   // start of hot region
+  uint16_t m_clock;        // write counter for m_stamp
+  uint32_t m_block[Slots];  // cold block in slot or EMPTY
+  uint16_t m_stamp[Slots];  // m_clock at last write
+  bool m_dirty[Slots];      // slot not copied to cold tier
+};
+#endif  // TieredRamDevice_h
@@ -0,0 +1,73 @@
+// Checkpoint a RamDisk volume to an SD image file.  Only regions
+// written since the last checkpoint are copied to the SD.
+#include <SPI.h>
+#include <SdFat.h>
+#include <RamDisk.h>
+#include <RamCheckpoint.h>
+#include <M23LCV1024.h>
+
+const uint8_t RAM_CS_PIN = 9;
+T23LCV1024<RAM_CS_PIN> ram;
+
+const uint8_t SD_CS_PIN = SS;
+
+// Time between checkpoints in millis.
+const uint32_t CHECKPOINT_INTERVAL_MS = 10000;
+
+#define IMAGE_NAME "RAMDISK.IMG"
+
+SdFat sd;
+SdBaseFile image;
+RamVolume vol;
+RamFile file;
+// One bit per region, enough for a 128 KB volume with one block clusters.
+uint8_t dirtyMap[32];
+// Copy buffer.
+uint8_t buf[64];
+uint32_t lastCheckpoint;
+//------------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  if (!sd.begin(SD_CS_PIN)) sd.errorHalt();
+  ram.begin();
+  if (!image.open(IMAGE_NAME, O_CREAT | O_RDWR)) {
+    sd.errorHalt("image open failed");
+  }
+  // Restore the last checkpoint if there is one.
+  if (image.fileSize() == 0
+    || !RamCheckpoint::restore(&vol, &ram, &image, buf, sizeof(buf))) {
+    Serial.println(F("Formatting RamDisk"));
+    if (!vol.format(&ram) || !vol.init(&ram)) {
+      Serial.println(F("format/init fail"));
+      while (1) {}
+    }
+  }
+  if (vol.dirtyMapSize() > sizeof(dirtyMap)) {
+    Serial.println(F("dirtyMap too small"));
+    while (1) {}
+  }
+  // Mark all regions dirty so the first checkpoint is complete.
+  vol.setDirtyMap(dirtyMap);
+  if (!file.open("LOG.TXT", O_CREAT | O_WRITE | O_APPEND)) {
+    Serial.println(F("open fail"));
+    while (1) {}
+  }
+  lastCheckpoint = millis();
+}
+//------------------------------------------------------------------------------
+void loop() {
+  file.print(millis());
+  file.print(',');
+  file.println(analogRead(0));
+  delay(100);
+  if ((millis() - lastCheckpoint) >= CHECKPOINT_INTERVAL_MS) {
+    lastCheckpoint = millis();
+    file.sync();
+    uint32_t m = micros();
+    if (!RamCheckpoint::save(&vol, &image, buf, sizeof(buf))) {
+      sd.errorHalt("checkpoint failed");
+    }
+    Serial.print(F("Checkpoint micros: "));
+    Serial.println(micros() - m);
+  }
+}
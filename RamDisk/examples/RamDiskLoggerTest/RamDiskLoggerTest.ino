@@ -13,6 +13,9 @@ const uint8_t  ANALOG_PIN_COUNT = 5;
 
 #define USE_MULTIPLE_CHIPS 0
 
+// Set nonzero to print device counts and latency by volume area.
+#define USE_INSTRUMENTED_DEVICE 0
+
 #if USE_FRAM
 #include <MB85RS2MT.h>
 #if USE_MULTIPLE_CHIPS
@@ -39,6 +42,13 @@ T23LCV1024<RAM_CS_PIN> ram;
 #endif  // USE_MULTIPLE_CHIPS
 #endif  // USE_FRAM
 
+#if USE_INSTRUMENTED_DEVICE
+#include <InstrumentedRamDevice.h>
+InstrumentedRamDevice dev;
+#else  // USE_INSTRUMENTED_DEVICE
+RamBaseDevice& dev = ram;
+#endif  // USE_INSTRUMENTED_DEVICE
+
 RamVolume vol;
 RamBaseFile file;
 uint16_t data[ANALOG_PIN_COUNT];
@@ -52,6 +62,9 @@ void setup() {
 #else  // USE_MULTIPLE_CHIPS
   ram.begin();
 #endif  // USE_MULTIPLE_CHIPS
+#if USE_INSTRUMENTED_DEVICE
+  dev.begin(&ram);
+#endif  // USE_INSTRUMENTED_DEVICE
 
   while (1) {
     // read any Serial input.
@@ -67,17 +80,20 @@ void setup() {
       // totalBlocks: entire RAM
       // dirBlocks: 4  (64 entries)
       // clusterSizeBlocks: 1 (one 512 byte block per cluster)
-      if (vol.format(&ram)) break;
+      if (vol.format(&dev)) break;
       Serial.println(F("format fail"));
       return;
     } else {
       Serial.println(F("Invalid entry"));
     }
   }
-  if (!vol.init(&ram)) {
+  if (!vol.init(&dev)) {
     Serial.println(F("init fail"));
     return;
   }
+#if USE_INSTRUMENTED_DEVICE
+  dev.attach(&vol);
+#endif  // USE_INSTRUMENTED_DEVICE
   vol.printInfo(&Serial);
   
   if (!file.open("TEST.BIN", O_CREAT | O_RDWR)) {
@@ -120,6 +136,10 @@ void setup() {
   Serial.println(m);
   Serial.print(F("filesize: "));
   Serial.println(file.fileSize());
+#if USE_INSTRUMENTED_DEVICE
+  Serial.println();
+  dev.printStats(&Serial);
+#endif  // USE_INSTRUMENTED_DEVICE
   
   file.rewind();
   Serial.println();
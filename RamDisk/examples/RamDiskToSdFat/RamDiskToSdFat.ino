@@ -4,6 +4,7 @@
 #include <SdFat.h>
 #include <SdFatUtil.h>
 #include <RamDisk.h>
+#include <RamSdExport.h>
 
 #define USE_FRAM 0
 
@@ -42,7 +43,10 @@ SdFat sd;
 SdBaseFile sdFile;
 RamVolume vol;
 RamFile ramFile;
-char buf[40];
+RamSdExport exporter;
+// Export buffer - split into two halves by RamSdExport.
+uint8_t buf[128];
+uint32_t pollCount = 0;
 //------------------------------------------------------------------------------
 void setup() {
   Serial.begin(9600);
@@ -105,17 +109,28 @@ void setup() {
     return;
   }
   Serial.println(F("Copying ramFile to sdFile"));
-  int n;
-  while ((n = ramFile.read(buf, sizeof(buf))) > 0) {
-    if (sdFile.write(buf, n) != n) {
-      Serial.println(F("sdFile.write failed"));
-      return;
-    }
+  if (!exporter.begin(&ramFile, &sdFile, buf, sizeof(buf))) {
+    Serial.println(F("exporter.begin failed"));
+    return;
   }
-  ramFile.close();
-  sdFile.close();
-  sd.ls(&Serial, LS_DATE | LS_SIZE);
-
-  Serial.println(F("Done"));
 }
-void loop() {}
\ No newline at end of file
+//------------------------------------------------------------------------------
+void loop() {
+  // Other work, like sampling, can be done here between export steps.
+  int8_t rtn = exporter.poll();
+  if (rtn == RamSdExport::EXPORT_BUSY) {
+    pollCount++;
+    return;
+  }
+  if (rtn == RamSdExport::EXPORT_ERROR) {
+    Serial.println(F("export failed"));
+  } else {
+    Serial.print(F("Export done, poll calls: "));
+    Serial.println(pollCount);
+    ramFile.close();
+    sdFile.close();
+    sd.ls(&Serial, LS_DATE | LS_SIZE);
+    Serial.println(F("Done"));
+  }
+  while (1) {}
+}
@@ -0,0 +1,98 @@
+// Log analog samples from a timer interrupt using RamLogQueue.
+// The ISR only copies a record into the queue.  loop() drains the
+// queue to a RamDisk file with cluster aligned writes.
+//
+// Uses Timer1 so this example is for AVR boards.
+#include <SPI.h>
+#include <RamDisk.h>
+
+#define USE_FRAM 0
+
+#if USE_FRAM
+#include <MB85RS2MT.h>
+const uint8_t RAM_CS_PIN = 9;
+T_MB85RS2MT<RAM_CS_PIN> ram;
+#else  // USE_FRAM
+#include <M23LCV1024.h>
+const uint8_t RAM_CS_PIN = 9;
+T23LCV1024<RAM_CS_PIN> ram;
+#endif  // USE_FRAM
+
+// Sample interval in micros.
+const uint16_t SAMPLE_INTERVAL_USEC = 1000;
+
+// Number of samples to log.
+const uint32_t SAMPLE_COUNT = 10000;
+
+// Max time for one call to drain.
+const uint32_t DRAIN_BUDGET_USEC = 200;
+
+struct record_t {
+  uint32_t time;
+  uint16_t adc[2];
+};
+// Queue of 32 slots - holds 31 records.
+RamLogQueue<sizeof(record_t), 32> queue;
+
+RamVolume vol;
+RamBaseFile file;
+
+volatile uint32_t sampleCount = 0;
+//------------------------------------------------------------------------------
+ISR(TIMER1_COMPA_vect) {
+  if (sampleCount >= SAMPLE_COUNT) return;
+  record_t* r = reinterpret_cast<record_t*>(queue.reserve());
+  sampleCount++;
+  // Overrun is counted by reserve.
+  if (!r) return;
+  r->time = micros();
+  r->adc[0] = analogRead(0);
+  r->adc[1] = analogRead(1);
+  queue.commit();
+}
+//------------------------------------------------------------------------------
+void startTimer() {
+  cli();
+  TCCR1A = 0;
+  // CTC mode with prescale of 8.
+  TCCR1B = (1 << WGM12) | (1 << CS11);
+  OCR1A = (F_CPU/8/1000000UL)*SAMPLE_INTERVAL_USEC - 1;
+  TIMSK1 = 1 << OCIE1A;
+  sei();
+}
+//------------------------------------------------------------------------------
+void stopTimer() {
+  TIMSK1 = 0;
+}
+//------------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  ram.begin();
+  if (!vol.format(&ram) || !vol.init(&ram)) {
+    Serial.println(F("format/init fail"));
+    return;
+  }
+  if (!file.open("ISRLOG.BIN", O_CREAT | O_RDWR | O_TRUNC)) {
+    Serial.println(F("open fail"));
+    return;
+  }
+  Serial.println(F("Logging"));
+  startTimer();
+  while (sampleCount < SAMPLE_COUNT || queue.available()) {
+    if (queue.drain(&file, DRAIN_BUDGET_USEC) < 0) {
+      Serial.println(F("write fail"));
+      break;
+    }
+  }
+  stopTimer();
+  file.close();
+  Serial.print(F("File size: "));
+  Serial.println(file.fileSize());
+  Serial.print(F("High water: "));
+  Serial.println(queue.highWater());
+  Serial.print(F("Overruns: "));
+  Serial.println(queue.overrunCount());
+  Serial.println(F("Done"));
+}
+//------------------------------------------------------------------------------
+void loop() {}
@@ -0,0 +1,90 @@
+// Log analog samples to a contiguous SD file with RamSdStager.
+// Samples are staged in external SRAM so SD write latency does not
+// cause lost data.  No Arduino SRAM is used for block buffers.
+#include <SPI.h>
+#include <SdFat.h>
+#include <SdFatUtil.h>
+#include <RamDisk.h>
+#include <RamSdStager.h>
+
+#define USE_FRAM 0
+
+#if USE_FRAM
+#include <MB85RS2MT.h>
+const uint8_t RAM_CS_PIN = 9;
+T_MB85RS2MT<RAM_CS_PIN> ram;
+#else  // USE_FRAM
+#include <M23LCV1024.h>
+const uint8_t RAM_CS_PIN = 9;
+T23LCV1024<RAM_CS_PIN> ram;
+#endif  // USE_FRAM
+
+const uint8_t SD_CS_PIN = SS;
+
+// Sample interval in micros.
+const uint32_t SAMPLE_INTERVAL_USEC = 500;
+
+// Size of the SD file in 512 byte blocks.
+const uint32_t FILE_BLOCK_COUNT = 2000;
+
+// Ring of 128 blocks, 64 KB, at the start of the RAM device.
+const uint16_t RING_BLOCK_COUNT = 128;
+
+#define FILENAME "STAGED.BIN"
+
+struct record_t {
+  uint32_t time;
+  uint16_t adc[2];
+};
+
+SdFat sd;
+SdBaseFile binFile;
+RamSdStager stager;
+//------------------------------------------------------------------------------
+void setup() {
+  Serial.begin(9600);
+  Serial.print(F("FreeRam: "));
+  Serial.println(FreeRam());
+  if (!sd.begin(SD_CS_PIN)) sd.errorHalt();
+  ram.begin();
+  sd.remove(FILENAME);
+  if (!binFile.createContiguous(sd.vwd(), FILENAME, 512*FILE_BLOCK_COUNT)) {
+    sd.errorHalt("createContiguous failed");
+  }
+  if (!stager.begin(&ram, 0, RING_BLOCK_COUNT, &binFile)) {
+    sd.errorHalt("stager.begin failed");
+  }
+  Serial.println(F("Logging - type any character to stop"));
+  uint32_t logTime = micros();
+  while (!Serial.available()) {
+    // Send staged blocks while waiting for the next sample time.
+    while ((int32_t)(micros() - logTime) < 0) {
+      if (!stager.poll()) sd.errorHalt("poll failed");
+    }
+    record_t r;
+    r.time = logTime;
+    r.adc[0] = analogRead(0);
+    r.adc[1] = analogRead(1);
+    logTime += SAMPLE_INTERVAL_USEC;
+    // A full file ends the run, otherwise the sample is counted as lost.
+    if (!stager.write(&r, sizeof(r)) &&
+      (stager.blocksWritten() + stager.depth()) >= FILE_BLOCK_COUNT) {
+      break;
+    }
+  }
+  if (!stager.finish()) sd.errorHalt("finish failed");
+  // Truncate unused blocks.
+  if (!binFile.truncate(512*stager.blocksWritten())) {
+    sd.errorHalt("truncate failed");
+  }
+  binFile.close();
+  Serial.print(F("Blocks written: "));
+  Serial.println(stager.blocksWritten());
+  Serial.print(F("Peak depth: "));
+  Serial.println(stager.peakDepth());
+  Serial.print(F("Overruns: "));
+  Serial.println(stager.overrunCount());
+  Serial.println(F("Done"));
+}
+//------------------------------------------------------------------------------
+void loop() {}
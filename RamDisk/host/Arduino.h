@@ -0,0 +1,121 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef Arduino_h
+#define Arduino_h
+/**
+ * \file
+ * Minimal Arduino API for building RamDisk host tools.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+//------------------------------------------------------------------------------
+/** Base for print() */
+#define DEC 10
+/** Base for print() */
+#define HEX 16
+/** Flash strings are ordinary strings on a host. */
+class __FlashStringHelper;
+/** Flash string macro */
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+unsigned long micros();
+unsigned long millis();
+//------------------------------------------------------------------------------
+/**
+ * \class Print
+ * \brief Subset of the Arduino Print class.
+ */
+class Print {
+ public:
+  /** Write a byte. \param[in] b byte \return bytes written */
+  virtual size_t write(uint8_t b) = 0;
+  /** Write bytes. \param[in] buf data \param[in] n count \return count */
+  virtual size_t write(const uint8_t* buf, size_t n) {
+    size_t r = 0;
+    while (n--) r += write(*buf++);
+    return r;
+  }
+  /** Write a string. \param[in] str string \return bytes written */
+  size_t write(const char* str) {
+    return write(reinterpret_cast<const uint8_t*>(str), strlen(str));
+  }
+  /** Print a string. \param[in] str string \return bytes written */
+  size_t print(const __FlashStringHelper* str) {
+    return write(reinterpret_cast<const char*>(str));
+  }
+  /** Print a string. \param[in] str string \return bytes written */
+  size_t print(const char* str) {return write(str);}
+  /** Print a character. \param[in] c character \return bytes written */
+  size_t print(char c) {return write((uint8_t)c);}
+  /** Print a number. \param[in] v value \param[in] base base
+   * \return bytes written */
+  size_t print(unsigned long v, int base = DEC) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%lu", v);
+    return write(buf);
+  }
+  /** Print a number. \param[in] v value \param[in] base base
+   * \return bytes written */
+  size_t print(long v, int base = DEC) {
+    if (base == HEX) return print((unsigned long)v, base);
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%ld", v);
+    return write(buf);
+  }
+  /** Print a number. \param[in] v value \param[in] base base
+   * \return bytes written */
+  size_t print(unsigned int v, int base = DEC) {
+    return print((unsigned long)v, base);
+  }
+  /** Print a number. \param[in] v value \param[in] base base
+   * \return bytes written */
+  size_t print(int v, int base = DEC) {return print((long)v, base);}
+  /** Print a number. \param[in] v value \param[in] base base
+   * \return bytes written */
+  size_t print(unsigned char v, int base = DEC) {
+    return print((unsigned long)v, base);
+  }
+  /** Print a number. \param[in] v value \param[in] digits decimal places
+   * \return bytes written */
+  size_t print(double v, int digits = 2) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", digits, v);
+    return write(buf);
+  }
+  /** Print end of line. \return bytes written */
+  size_t println() {return write("\r\n");}
+  /** Print a value and end of line. \param[in] v value
+   * \return bytes written */
+  template<class T> size_t println(T v) {
+    size_t n = print(v);
+    return n + println();
+  }
+  /** Print a value and end of line. \param[in] v value \param[in] b base
+   * \return bytes written */
+  template<class T> size_t println(T v, int b) {
+    size_t n = print(v, b);
+    return n + println();
+  }
+};
+#endif  // Arduino_h
@@ -0,0 +1,130 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef MemRamDevice_h
+#define MemRamDevice_h
+/**
+ * \file
+ * MemRamDevice class
+ */
+#include <RamBaseDevice.h>
+//------------------------------------------------------------------------------
+/**
+ * \class MemRamDevice
+ * \brief RAM device in host memory for host tools.
+ */
+class MemRamDevice : public RamBaseDevice {
+ public:
+  /** Create a device with no memory. */
+  MemRamDevice() : m_mem(0), m_blocks(0) {clearCounts();}
+  ~MemRamDevice() {delete[] m_mem;}
+  /**
+   * Allocate memory for the device.
+   *
+   * \param[in] blocks Size of the device in 512 byte blocks.
+   *
+   * \return true for success or false for failure.
+   */
+  bool begin(uint32_t blocks) {
+    delete[] m_mem;
+    m_mem = new uint8_t[512*blocks];
+    m_blocks = blocks;
+    memset(m_mem, 0XFF, 512*blocks);
+    return true;
+  }
+  /** Set transaction counts to zero. */
+  void clearCounts() {
+    m_reads = m_readBytes = m_writes = m_writeBytes = 0;
+  }
+  /**
+   * Fill a region of the device in one transaction like the SPI drivers.
+   *
+   * \param[in] address Start of the region.
+   *
+   * \param[in] value Value stored in each byte.
+   *
+   * \param[in] length Number of bytes in the region.
+   *
+   * \return true for success or false for failure.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    if (address + length > 512*m_blocks) return false;
+    m_writes++;
+    m_writeBytes += length;
+    memset(m_mem + address, value, length);
+    return true;
+  }
+  /** \return Pointer to the memory of the device. */
+  uint8_t* mem() {return m_mem;}
+  /**
+   * Read data from the device.
+   *
+   * \param[in] address Location to be read.
+   *
+   * \param[out] buf Pointer to the location that will receive the data.
+   *
+   * \param[in] nbyte Number of bytes to read.
+   *
+   * \return true for success or false for failure.
+   */
+  bool read(uint32_t address, void *buf, size_t nbyte) {
+    if (address + nbyte > 512*m_blocks) return false;
+    m_reads++;
+    m_readBytes += nbyte;
+    memcpy(buf, m_mem + address, nbyte);
+    return true;
+  }
+  /** \return Number of read calls. */
+  uint32_t readCount() {return m_reads;}
+  /** \return Number of bytes read. */
+  uint32_t readBytes() {return m_readBytes;}
+  /** \return Size of the device in 512 byte blocks. */
+  uint32_t sizeBlocks() {return m_blocks;}
+  /**
+   * Write data to the device.
+   *
+   * \param[in] address Location to be written.
+   *
+   * \param[in] buf Pointer to the location of the data to be written.
+   *
+   * \param[in] nbyte Number of bytes to write.
+   *
+   * \return true for success or false for failure.
+   */
+  bool write(uint32_t address, const void *buf, size_t nbyte) {
+    if (address + nbyte > 512*m_blocks) return false;
+    m_writes++;
+    m_writeBytes += nbyte;
+    memcpy(m_mem + address, buf, nbyte);
+    return true;
+  }
+  /** \return Number of write calls. */
+  uint32_t writeCount() {return m_writes;}
+  /** \return Number of bytes written. */
+  uint32_t writeBytes() {return m_writeBytes;}
+
+ private:
+  uint8_t* m_mem;
+  uint32_t m_blocks;
+  uint32_t m_reads;
+  uint32_t m_readBytes;
+  uint32_t m_writes;
+  uint32_t m_writeBytes;
+};
+#endif  // MemRamDevice_h
@@ -0,0 +1,306 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// File system benchmarks on a memory device.
+//
+// usage: RamBench [-b blocks] [-c clusterBlocks]
+//                 [-s 23LCV1024|MB85RS2MT] [-m cpuMHz] [-k divider]
+//
+// Prints one CSV line per measurement:
+//
+//   test,param,ops,micros,reads,readBytes,writes,writeBytes,busMicros
+//
+// ops is the number of API calls timed, micros is host time for all
+// calls and the next four fields are device transactions and bytes.
+// Device counts do not depend on the host so they are the best values
+// to compare between commits.
+//
+// -s runs the volume on a SpiModelRamDevice and busMicros is the
+// estimated SPI bus time on a board with the given CPU clock, default
+// 16 MHz, and SPI clock divider, default 2.  The device is rounded up
+// to a whole number of chips.  Without -s busMicros is zero.
+#include <RamDisk.h>
+#include "MemRamDevice.h"
+#include "SpiModelRamDevice.h"
+//------------------------------------------------------------------------------
+static MemRamDevice dev;
+static SpiModelRamDevice spi;
+// Device used by the volume, dev or spi.
+static RamBaseDevice* target = &dev;
+static RamVolume vol;
+static uint8_t clusterBlocks = 1;
+static uint8_t buf[32768];
+static unsigned long startMicros;
+// Size of files for read and write tests, a multiple of 32768.
+static uint32_t fileSize;
+//------------------------------------------------------------------------------
+static void fail(const char* msg) {
+  fprintf(stderr, "error: %s\n", msg);
+  exit(1);
+}
+//------------------------------------------------------------------------------
+static void start() {
+  dev.clearCounts();
+  spi.clearCounts();
+  startMicros = micros();
+}
+//------------------------------------------------------------------------------
+static void stop(const char* test, unsigned long param, unsigned long ops) {
+  unsigned long us = micros() - startMicros;
+  printf("%s,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.0f\n", test, param, ops, us,
+         (unsigned long)dev.readCount(), (unsigned long)dev.readBytes(),
+         (unsigned long)dev.writeCount(), (unsigned long)dev.writeBytes(),
+         target == &spi ? spi.busMicros() : 0.0);
+}
+//------------------------------------------------------------------------------
+static void newVolume(uint8_t dirBlocks) {
+  if (!vol.format(target, 0, dirBlocks, clusterBlocks)
+      || !vol.init(target)) {
+    fail("format");
+  }
+}
+//------------------------------------------------------------------------------
+static void benchFormat() {
+  static const uint8_t option[] = {
+    0, RAM_FORMAT_QUICK, RAM_FORMAT_FAT_BOOT
+  };
+  for (uint8_t i = 0; i < sizeof(option); i++) {
+    start();
+    if (!vol.format(target, 0, 4, clusterBlocks, option[i])) fail("format");
+    stop("format", option[i], 1);
+  }
+}
+//------------------------------------------------------------------------------
+static void benchSequential() {
+  static const uint16_t size[] = {1, 8, 64, 512, 4096, 32768};
+  RamBaseFile file;
+  for (uint8_t i = 0; i < sizeof(size)/sizeof(size[0]); i++) {
+    uint32_t n = fileSize/size[i];
+    newVolume(4);
+    start();
+    if (!file.open(&vol, "SEQ.BIN", O_CREAT | O_RDWR)) fail("open");
+    for (uint32_t k = 0; k < n; k++) {
+      if (file.write(buf, size[i]) != size[i]) fail("write");
+    }
+    if (!file.close()) fail("close");
+    stop("write", size[i], n);
+
+    if (!file.open(&vol, "SEQ.BIN", O_READ)) fail("open");
+    start();
+    for (uint32_t k = 0; k < n; k++) {
+      if (file.read(buf, size[i]) != size[i]) fail("read");
+    }
+    stop("read", size[i], n);
+    file.close();
+  }
+}
+//------------------------------------------------------------------------------
+static void benchSeek() {
+  const uint32_t N = 10000;
+  RamBaseFile file;
+  newVolume(4);
+  if (!file.open(&vol, "SEEK.BIN", O_CREAT | O_RDWR)) fail("open");
+  for (uint32_t k = 0; k < fileSize; k += sizeof(buf)) {
+    if (file.write(buf, sizeof(buf)) != sizeof(buf)) fail("write");
+  }
+  srand(1);
+  start();
+  for (uint32_t k = 0; k < N; k++) {
+    if (!file.seekSet(rand() % (fileSize - 4))) fail("seek");
+    if (file.read(buf, 4) != 4) fail("read");
+  }
+  stop("seek_read", fileSize, N);
+  file.close();
+}
+//------------------------------------------------------------------------------
+static void benchOpen() {
+  // 16 blocks, 256 directory entries.
+  static const uint16_t fill[] = {1, 64, 128, 255};
+  const uint32_t N = 1000;
+  char name[13];
+  RamBaseFile file;
+  newVolume(16);
+  uint16_t count = 0;
+  for (uint8_t i = 0; i < sizeof(fill)/sizeof(fill[0]); i++) {
+    for (; count < fill[i]; count++) {
+      sprintf(name, "F%05u.DAT", count);
+      if (!file.open(&vol, name, O_CREAT | O_WRITE)) fail("create");
+      file.close();
+    }
+    start();
+    for (uint32_t k = 0; k < N; k++) {
+      if (!file.open(&vol, name, O_READ)) fail("open");
+      file.close();
+    }
+    stop("open_hit", count, N);
+    start();
+    for (uint32_t k = 0; k < N; k++) {
+      if (file.open(&vol, "MISSING.DAT", O_READ)) fail("open");
+    }
+    stop("open_miss", count, N);
+  }
+}
+//------------------------------------------------------------------------------
+static void benchSync() {
+  const uint32_t N = 1000;
+  RamBaseFile file;
+  newVolume(4);
+  if (!file.open(&vol, "SYNC.BIN", O_CREAT | O_WRITE)) fail("open");
+  start();
+  for (uint32_t k = 0; k < N; k++) {
+    if (file.write(buf, 16) != 16 || !file.sync()) fail("sync");
+  }
+  stop("write16_sync", 16, N);
+  start();
+  for (uint32_t k = 0; k < N; k++) {
+    if (!file.sync()) fail("sync");
+  }
+  stop("sync_clean", 0, N);
+  file.close();
+}
+//------------------------------------------------------------------------------
+static void benchFragmented() {
+  const uint8_t FILES = 32;
+  char name[13];
+  RamBaseFile file[FILES];
+  newVolume(4);
+  // Use up to a quarter of the volume.
+  uint8_t rounds = vol.clusterCount()/(4*FILES) < 8
+                   ? vol.clusterCount()/(4*FILES) : 8;
+  if (rounds == 0) return;
+  // Interleave clusters of many files then remove every other file.
+  for (uint8_t i = 0; i < FILES; i++) {
+    sprintf(name, "F%02u.DAT", i);
+    if (!file[i].open(&vol, name, O_CREAT | O_WRITE)) fail("create");
+  }
+  for (uint8_t k = 0; k < rounds; k++) {
+    for (uint8_t i = 0; i < FILES; i++) {
+      uint16_t n = vol.clusterSizeBytes();
+      if (file[i].write(buf, n) != n) fail("write");
+    }
+  }
+  for (uint8_t i = 0; i < FILES; i++) {
+    if (i & 1) {
+      if (!file[i].remove()) fail("remove");
+    } else {
+      file[i].close();
+    }
+  }
+  if (!vol.reclaim(0XFFFF)) fail("reclaim");
+  uint32_t n = rounds*(FILES/2)*vol.clusterSizeBytes();
+  start();
+  if (!file[1].open(&vol, "NEW.DAT", O_CREAT | O_WRITE)) fail("open");
+  for (uint32_t k = 0; k < n; k += 512) {
+    if (file[1].write(buf, 512) != 512) fail("write");
+  }
+  if (!file[1].close()) fail("close");
+  stop("write_fragmented", n, n/512);
+}
+//------------------------------------------------------------------------------
+static void benchPrint() {
+  // Lines are less than 16 bytes.
+  const uint32_t N = fileSize/16;
+  RamFile file;
+  RamStream stream;
+  newVolume(4);
+  if (!file.open(&vol, "PRINT.TXT", O_CREAT | O_WRITE)) fail("open");
+  start();
+  for (uint32_t k = 0; k < N; k++) {
+    file.print(k);
+    file.write(',');
+    file.println(k*0.5, 2);
+  }
+  file.close();
+  stop("print", 0, N);
+
+  vol.chvol();
+  if (!stream.fopen("STREAM.TXT", "w")) fail("fopen");
+  start();
+  for (uint32_t k = 0; k < N; k++) {
+    stream.printField(k, ',');
+    stream.printField(k*0.5, '\n', 2);
+  }
+  stream.fclose();
+  stop("stream_print", 0, N);
+}
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+  uint32_t blocks = 1024;
+  const char* model = 0;
+  uint32_t cpuMHz = 16;
+  uint8_t divider = 2;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      blocks = strtoul(argv[++i], 0, 0);
+    } else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+      clusterBlocks = strtoul(argv[++i], 0, 0);
+    } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      model = argv[++i];
+    } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+      cpuMHz = strtoul(argv[++i], 0, 0);
+    } else if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+      divider = strtoul(argv[++i], 0, 0);
+    } else {
+      fprintf(stderr, "usage: RamBench [-b blocks] [-c clusterBlocks]"
+              " [-s 23LCV1024|MB85RS2MT] [-m cpuMHz] [-k divider]\n");
+      return 1;
+    }
+  }
+  if (model) {
+    uint8_t type;
+    if (!strcmp(model, "23LCV1024")) {
+      type = SPI_MODEL_23LCV1024;
+    } else if (!strcmp(model, "MB85RS2MT")) {
+      type = SPI_MODEL_MB85RS2MT;
+    } else {
+      fprintf(stderr, "unknown device %s\n", model);
+      return 1;
+    }
+    uint32_t chipBlocks = type == SPI_MODEL_MB85RS2MT ? 512 : 256;
+    uint32_t chips = (blocks + chipBlocks - 1)/chipBlocks;
+    if (chips == 0 || chips > 255) {
+      fprintf(stderr, "bad device size\n");
+      return 1;
+    }
+    blocks = chips*chipBlocks;
+    dev.begin(blocks);
+    if (!spi.begin(&dev, type, chips, 1000000*cpuMHz, divider)) {
+      fail("SpiModelRamDevice");
+    }
+    target = &spi;
+  } else {
+    dev.begin(blocks);
+  }
+  // Files use no more than half the device.
+  fileSize = blocks/128*32768 < 131072 ? blocks/128*32768 : 131072;
+  if (fileSize == 0) {
+    fprintf(stderr, "blocks must be at least 128\n");
+    return 1;
+  }
+  printf("test,param,ops,micros,reads,readBytes,writes,writeBytes,"
+         "busMicros\n");
+  benchFormat();
+  benchSequential();
+  benchSeek();
+  benchOpen();
+  benchSync();
+  benchFragmented();
+  benchPrint();
+  return 0;
+}
@@ -0,0 +1,249 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+// Replay a RamTrace against volumes in memory and print device counts.
+//
+// usage: RamTraceReplay TRACE [-b blocks] [-d dirBlocks,...]
+//                             [-c clusterBlocks,...] [-q] [-f]
+//
+// TRACE is the output of RamTrace::printHex().  The trace is replayed on
+// an empty volume for each combination of directory and cluster sizes.
+// -q selects RAM_FORMAT_QUICK and -f selects RAM_FORMAT_FAT_BOOT.
+// One CSV line is printed for each volume.
+#include <ctype.h>
+#include <RamDisk.h>
+#include <InstrumentedRamDevice.h>
+#include "MemRamDevice.h"
+//------------------------------------------------------------------------------
+static uint8_t* trace;
+static uint32_t traceLength;
+static uint8_t* data;
+static size_t dataSize;
+//------------------------------------------------------------------------------
+static void usage() {
+  fprintf(stderr, "usage: RamTraceReplay TRACE [-b blocks] "
+          "[-d dirBlocks,...] [-c clusterBlocks,...] [-q] [-f]\n");
+  exit(1);
+}
+//------------------------------------------------------------------------------
+// Parse a comma separated list of numbers.
+static int parseList(const char* str, unsigned* list, int max) {
+  int n = 0;
+  while (*str && n < max) {
+    char* end;
+    list[n++] = strtoul(str, &end, 0);
+    if (end == str) usage();
+    str = *end == ',' ? end + 1 : end;
+  }
+  return n;
+}
+//------------------------------------------------------------------------------
+// Read hex pairs, ignoring other characters, and check the header.
+static bool readTrace(const char* path) {
+  FILE* fp = fopen(path, "r");
+  size_t size = 4096;
+  size_t n = 0;
+  int c;
+  int hi = -1;
+  if (!fp) return false;
+  trace = reinterpret_cast<uint8_t*>(malloc(size));
+  while ((c = fgetc(fp)) != EOF) {
+    if (!isxdigit(c)) continue;
+    int v = isdigit(c) ? c - '0' : toupper(c) - 'A' + 10;
+    if (hi < 0) {
+      hi = v;
+      continue;
+    }
+    if (n == size) {
+      size *= 2;
+      trace = reinterpret_cast<uint8_t*>(realloc(trace, size));
+    }
+    trace[n++] = hi << 4 | v;
+    hi = -1;
+  }
+  fclose(fp);
+  if (n < RAM_TRACE_HEADER_SIZE) return false;
+  uint32_t magic;
+  memcpy(&magic, trace, 4);
+  memcpy(&traceLength, trace + 4, 4);
+  return magic == RAM_TRACE_MAGIC
+         && traceLength <= n - RAM_TRACE_HEADER_SIZE;
+}
+//------------------------------------------------------------------------------
+// Make room for a read or write of n bytes.
+static uint8_t* dataBuf(size_t n) {
+  if (n > dataSize) {
+    dataSize = n;
+    data = reinterpret_cast<uint8_t*>(realloc(data, n));
+    for (size_t i = 0; i < n; i++) data[i] = i;
+  }
+  return data;
+}
+//------------------------------------------------------------------------------
+static uint32_t varint(uint32_t* i) {
+  uint32_t v = 0;
+  for (uint8_t shift = 0; *i < traceLength; shift += 7) {
+    uint8_t b = trace[RAM_TRACE_HEADER_SIZE + (*i)++];
+    v |= (uint32_t)(b & 0X7F) << shift;
+    if (!(b & 0X80)) break;
+  }
+  return v;
+}
+//------------------------------------------------------------------------------
+// Replay all records.  Return the number of calls that failed.
+static uint32_t replay(RamVolume* vol, uint32_t* calls) {
+  RamBaseFile file[RAM_TRACE_FILES];
+  uint32_t errors = 0;
+  uint32_t i = 0;
+  *calls = 0;
+  while (i < traceLength) {
+    uint8_t b = trace[RAM_TRACE_HEADER_SIZE + i++];
+    RamBaseFile* f = &file[b & 7];
+    bool ok;
+    uint32_t n;
+    (*calls)++;
+    switch (b >> 3) {
+      case RAM_TRACE_OPEN: {
+        const uint8_t* p = trace + RAM_TRACE_HEADER_SIZE + i;
+        char name[13];
+        uint8_t k = 0;
+        if (i + 12 > traceLength) return errors + 1;
+        for (uint8_t j = 1; j < 12; j++) {
+          if (j == 9) name[k++] = '.';
+          if (p[j] != ' ') name[k++] = p[j];
+        }
+        if (name[k - 1] == '.') k--;
+        name[k] = 0;
+        ok = f->open(vol, name, p[0]);
+        i += 12;
+        break;
+      }
+      case RAM_TRACE_CLOSE:
+        ok = f->close();
+        break;
+
+      case RAM_TRACE_READ:
+        n = varint(&i);
+        ok = f->read(dataBuf(n), n) >= 0;
+        break;
+
+      case RAM_TRACE_WRITE:
+        n = varint(&i);
+        ok = f->write(dataBuf(n), n) == (int)n;
+        break;
+
+      case RAM_TRACE_SEEK:
+        ok = f->seekSet(varint(&i));
+        break;
+
+      case RAM_TRACE_SYNC:
+        ok = f->sync();
+        break;
+
+      case RAM_TRACE_TRUNCATE:
+        ok = f->truncate(varint(&i));
+        break;
+
+      case RAM_TRACE_REMOVE:
+        ok = f->remove();
+        break;
+
+      default:
+        fprintf(stderr, "bad record type at %lu\n", (unsigned long)i - 1);
+        return errors + 1;
+    }
+    if (!ok) errors++;
+  }
+  return errors;
+}
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[]) {
+  unsigned blocks = 256;
+  unsigned dirList[16] = {4};
+  unsigned clusterList[16] = {1};
+  int dirCount = 1;
+  int clusterCount = 1;
+  uint8_t options = 0;
+  const char* path = 0;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      blocks = strtoul(argv[++i], 0, 0);
+    } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+      dirCount = parseList(argv[++i], dirList, 16);
+    } else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+      clusterCount = parseList(argv[++i], clusterList, 16);
+    } else if (!strcmp(argv[i], "-q")) {
+      options |= RAM_FORMAT_QUICK;
+    } else if (!strcmp(argv[i], "-f")) {
+      options |= RAM_FORMAT_FAT_BOOT;
+    } else if (argv[i][0] != '-' && !path) {
+      path = argv[i];
+    } else {
+      usage();
+    }
+  }
+  if (!path) usage();
+  if (!readTrace(path)) {
+    fprintf(stderr, "can't read trace %s\n", path);
+    return 1;
+  }
+  printf("dirBlocks,clusterBlocks,calls,errors,freeClusters,fragments");
+  const char* area[] = {"params", "fat", "dir", "data"};
+  for (uint8_t c = 0; c < RAM_IO_CLASS_COUNT; c++) {
+    printf(",%sReads,%sReadBytes,%sWrites,%sWriteBytes",
+           area[c], area[c], area[c], area[c]);
+  }
+  printf("\n");
+  for (int d = 0; d < dirCount; d++) {
+    for (int c = 0; c < clusterCount; c++) {
+      MemRamDevice mem;
+      InstrumentedRamDevice dev;
+      RamVolume vol;
+      uint32_t calls;
+      mem.begin(blocks);
+      dev.begin(&mem);
+      if (!vol.format(&dev, 0, dirList[d], clusterList[c], options)
+          || !vol.init(&dev)) {
+        fprintf(stderr, "format failed dirBlocks %u clusterBlocks %u\n",
+                dirList[d], clusterList[c]);
+        continue;
+      }
+      dev.attach(&vol);
+      dev.clearStats();
+      uint32_t errors = replay(&vol, &calls);
+      // Save counts before the volume queries below add to them.
+      RamIoCounts counts[RAM_IO_CLASS_COUNT];
+      for (uint8_t k = 0; k < RAM_IO_CLASS_COUNT; k++) {
+        counts[k] = *dev.counts(k);
+      }
+      printf("%u,%u,%lu,%lu,%lu,%lu", dirList[d], clusterList[c],
+             (unsigned long)calls, (unsigned long)errors,
+             (unsigned long)vol.freeClusterCount(),
+             (unsigned long)vol.fragmentCount());
+      for (uint8_t k = 0; k < RAM_IO_CLASS_COUNT; k++) {
+        printf(",%lu,%lu,%lu,%lu", (unsigned long)counts[k].reads,
+               (unsigned long)counts[k].readBytes,
+               (unsigned long)counts[k].writes,
+               (unsigned long)counts[k].writeBytes);
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,217 @@
+/* Arduino RamDisk Library
+ * Copyright (C) 2014 by William Greiman
+ *
+ * This file is part of the Arduino RamDisk Library
+ *
+ * This Library is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This Library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with the Arduino RamDisk Library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+#ifndef SpiModelRamDevice_h
+#define SpiModelRamDevice_h
+/**
+ * \file
+ * SpiModelRamDevice class
+ */
+#include <RamBaseDevice.h>
+//------------------------------------------------------------------------------
+/** Model of the M23LCV1024 driver, 128 KB chips. */
+const uint8_t SPI_MODEL_23LCV1024 = 0;
+/** Model of the MB85RS2MT driver, 256 KB chips, WREN before writes. */
+const uint8_t SPI_MODEL_MB85RS2MT = 1;
+//------------------------------------------------------------------------------
+/**
+ * \class SpiModelRamDevice
+ * \brief Estimate SPI bus time for operations on another device.
+ *
+ * Operations are passed to a memory device and the time the M23LCV1024
+ * or MB85RS2MT driver would take on a board is added to busMicros().
+ *
+ * Each transaction costs transactionCycles for chip select and call
+ * overhead, a command byte and three address bytes.  MB85RS2MT writes
+ * and fills also send WREN with an extra chip select.  Each byte costs
+ * 8*divider cycles of SPI clock plus byteCycles of loop overhead.
+ *
+ * Transactions are split at chip boundaries.  fill() is split by the
+ * drivers.  The drivers do not split read() or write() so crossings are
+ * also counted by boundaryCrossings() since they would wrap on a board.
+ */
+class SpiModelRamDevice : public RamBaseDevice {
+ public:
+  /** Create a device.  Calls fail until begin() is called. */
+  SpiModelRamDevice() : m_mem(0) {}
+  //----------------------------------------------------------------------------
+  /**
+   * Initialize the model.
+   *
+   * \param[in] mem Memory device for the data.
+   * \param[in] model SPI_MODEL_23LCV1024 or SPI_MODEL_MB85RS2MT.
+   * \param[in] chipCount Number of chips.
+   * \param[in] cpuHz CPU clock in Hz.
+   * \param[in] divider SPI clock divider.
+   * \param[in] transactionCycles CPU cycles per chip select.
+   * \param[in] byteCycles CPU cycles between bytes.
+   *
+   * \return true for success or false for failure.
+   */
+  bool begin(RamBaseDevice* mem, uint8_t model, uint8_t chipCount = 1,
+             uint32_t cpuHz = 16000000, uint8_t divider = 2,
+             uint16_t transactionCycles = 40, uint8_t byteCycles = 2) {
+    m_chipShift = model == SPI_MODEL_MB85RS2MT ? 18 : 17;
+    if (chipCount == 0
+        || mem->sizeBlocks() < ((uint32_t)chipCount << (m_chipShift - 9))) {
+      return false;
+    }
+    m_mem = mem;
+    m_model = model;
+    m_chipCount = chipCount;
+    m_cpuHz = cpuHz;
+    m_byteCycles = 8*divider + byteCycles;
+    m_transactionCycles = transactionCycles;
+    clearCounts();
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Reads and writes that cross a chip boundary. */
+  uint32_t boundaryCrossings() {return m_crossings;}
+  //----------------------------------------------------------------------------
+  /** \return Estimated bus time in microseconds. */
+  double busMicros() {return 1e6*m_cycles/m_cpuHz;}
+  //----------------------------------------------------------------------------
+  /** Set all counts and the bus time to zero. */
+  void clearCounts() {
+    m_cycles = 0;
+    m_transactions = 0;
+    m_wireBytes = 0;
+    m_crossings = 0;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Fill a region of the device.
+   *
+   * \param[in] address Start of the region.
+   *
+   * \param[in] value Value stored in each byte.
+   *
+   * \param[in] length Number of bytes in the region.
+   *
+   * \return true for success or false for failure.
+   */
+  bool fill(uint32_t address, uint8_t value, uint32_t length) {
+    while (length) {
+      uint32_t n = chipLeft(address, length);
+      if (!n || !m_mem->fill(address, value, n)) return false;
+      charge(n, true);
+      address += n;
+      length -= n;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /**
+   * Read data from the device.
+   *
+   * \param[in] address Location to be read.
+   *
+   * \param[out] buf Pointer to the location that will receive the data.
+   *
+   * \param[in] nbyte Number of bytes to read.
+   *
+   * \return true for success or false for failure.
+   */
+  bool read(uint32_t address, void *buf, size_t nbyte) {
+    uint8_t* dst = reinterpret_cast<uint8_t*>(buf);
+    if (chipLeft(address, nbyte) < nbyte) m_crossings++;
+    while (nbyte) {
+      uint32_t n = chipLeft(address, nbyte);
+      if (!n || !m_mem->read(address, dst, n)) return false;
+      charge(n, false);
+      address += n;
+      dst += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of 512 byte blocks in all chips. */
+  uint32_t sizeBlocks() {
+    return m_mem ? (uint32_t)m_chipCount << (m_chipShift - 9) : 0;
+  }
+  //----------------------------------------------------------------------------
+  /** \return Number of chip select cycles. */
+  uint32_t transactions() {return m_transactions;}
+  //----------------------------------------------------------------------------
+  /** \return Bytes sent and received including commands and addresses. */
+  uint32_t wireBytes() {return m_wireBytes;}
+  //----------------------------------------------------------------------------
+  /**
+   * Write data to the device.
+   *
+   * \param[in] address Location to be written.
+   *
+   * \param[in] buf Pointer to the location of the data to be written.
+   *
+   * \param[in] nbyte Number of bytes to write.
+   *
+   * \return true for success or false for failure.
+   */
+  bool write(uint32_t address, const void *buf, size_t nbyte) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(buf);
+    if (chipLeft(address, nbyte) < nbyte) m_crossings++;
+    while (nbyte) {
+      uint32_t n = chipLeft(address, nbyte);
+      if (!n || !m_mem->write(address, src, n)) return false;
+      charge(n, true);
+      address += n;
+      src += n;
+      nbyte -= n;
+    }
+    return true;
+  }
+
+ private:
+  // Add the cost of one command with n data bytes.
+  void charge(uint32_t n, bool write) {
+    uint8_t selects = 1;
+    uint32_t bytes = 4 + n;
+    if (write && m_model == SPI_MODEL_MB85RS2MT) {
+      // WREN has its own chip select.
+      selects++;
+      bytes++;
+    }
+    m_transactions += selects;
+    m_wireBytes += bytes;
+    m_cycles += (double)selects*m_transactionCycles
+                + (double)bytes*m_byteCycles;
+  }
+  // Bytes to the end of the chip, at most n.  Zero if past the last chip.
+  uint32_t chipLeft(uint32_t address, uint32_t n) {
+    if ((address >> m_chipShift) >= m_chipCount) return 0;
+    uint32_t chipSize = 1UL << m_chipShift;
+    uint32_t left = chipSize - (address & (chipSize - 1));
+    return left < n ? left : n;
+  }
+
+  RamBaseDevice* m_mem;          // memory for the data
+  uint8_t m_model;               // SPI_MODEL_23LCV1024 or SPI_MODEL_MB85RS2MT
+  uint8_t m_chipCount;           // number of chips
+  uint8_t m_chipShift;           // log2 of chip size in bytes
+  uint32_t m_cpuHz;              // CPU clock
+  uint16_t m_byteCycles;         // CPU cycles per byte
+  uint16_t m_transactionCycles;  // CPU cycles per chip select
+  double m_cycles;               // estimated CPU cycles on the bus
+  uint32_t m_transactions;       // chip select cycles
+  uint32_t m_wireBytes;          // bytes on the bus
+  uint32_t m_crossings;          // reads and writes that cross chips
+};
+#endif  // SpiModelRamDevice_h
@@ -1131,6 +1131,13 @@ int SdBaseFile::read(void* buf, size_t nbyte) {
           goto fail;
         }
       }
+#if USE_RAM_L2_CACHE
+      // write dirty L2 blocks that will be read
+      if (!m_vol->cacheL2SyncRange(block, nb)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+#endif  // USE_RAM_L2_CACHE
       if (!m_vol->sdCard()->readStart(block)) {
         DBG_FAIL_MACRO;
         goto fail;
@@ -1977,6 +1984,10 @@ int SdBaseFile::write(const void* buf, size_t nbyte) {
       if (nBlock > maxBlocks) nBlock = maxBlocks;
 
       n = 512*nBlock;
+#if USE_RAM_L2_CACHE
+      // drop L2 blocks that will be overwritten
+      m_vol->cacheL2InvalidateRange(block, nBlock);
+#endif  // USE_RAM_L2_CACHE
       if (!m_vol->sdCard()->writeStart(block, nBlock)) {
         DBG_FAIL_MACRO;
         goto fail;
@@ -71,6 +71,22 @@
  */
 #define USE_MULTIPLE_CARDS 0
 //------------------------------------------------------------------------------
+/**
+ * Set USE_RAM_L2_CACHE nonzero to keep blocks evicted from the SdVolume
+ * cache in an external RAM device.  The RamDisk library must be installed.
+ *
+ * Enable the cache with SdVolume::cacheL2Begin().  The RAM device region
+ * must hold RAM_L2_CACHE_SLOTS 512 byte blocks.
+ *
+ * The L2 cache requires USE_MULTIPLE_CARDS zero.
+ */
+#define USE_RAM_L2_CACHE 0
+/**
+ * Number of 512 byte blocks in the RAM L2 cache.  Each block
+ * uses seven bytes of Arduino SRAM for its tag.
+ */
+#define RAM_L2_CACHE_SLOTS 32
+//------------------------------------------------------------------------------
 /**
  * Set DESTRUCTOR_CLOSES_FILE nonzero to close a file in its destructor.
  *
@@ -33,6 +33,16 @@ uint8_t  SdVolume::m_cacheFatStatus;       // status of cache Fatblock
 #endif  // USE_SEPARATE_FAT_CACHE
 Sd2Card* SdVolume::m_sdCard;            // pointer to SD card object
 #endif  // USE_MULTIPLE_CARDS
+#if USE_RAM_L2_CACHE
+RamBaseDevice* SdVolume::m_l2Dev;       // RAM device for L2 blocks
+uint32_t SdVolume::m_l2Address;         // RAM address of first L2 block
+uint16_t SdVolume::m_l2Clock;           // LRU clock
+uint32_t SdVolume::m_l2HitCount;        // fetches from L2
+uint32_t SdVolume::m_l2MissCount;       // fetches from SD
+uint32_t SdVolume::m_l2Block[RAM_L2_CACHE_SLOTS];  // block in slot
+uint16_t SdVolume::m_l2Use[RAM_L2_CACHE_SLOTS];    // LRU time of slot
+uint8_t  SdVolume::m_l2Status[RAM_L2_CACHE_SLOTS];  // CACHE_STATUS bits
+#endif  // USE_RAM_L2_CACHE
 //------------------------------------------------------------------------------
 // find a contiguous group of clusters
 bool SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
@@ -130,6 +140,23 @@ cache_t* SdVolume::cacheFetch(uint32_t blockNumber, uint8_t options) {
 //------------------------------------------------------------------------------
 cache_t* SdVolume::cacheFetchData(uint32_t blockNumber, uint8_t options) {
   if (m_cacheBlockNumber != blockNumber) {
+#if USE_RAM_L2_CACHE
+    if (m_cacheBlockNumber != 0XFFFFFFFF) {
+      if (!cacheL2Evict(m_cacheBlockNumber, m_cacheBuffer.data,
+                        m_cacheStatus & CACHE_STATUS_DIRTY)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    }
+    m_cacheBlockNumber = 0XFFFFFFFF;
+    m_cacheStatus = 0;
+    if (options & CACHE_OPTION_NO_READ) {
+      cacheL2InvalidateRange(blockNumber, 1);
+    } else if (!cacheL2Fetch(blockNumber, m_cacheBuffer.data, &m_cacheStatus)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+#else  // USE_RAM_L2_CACHE
     if (!cacheWriteData()) {
       DBG_FAIL_MACRO;
       goto fail;
@@ -141,6 +168,7 @@ cache_t* SdVolume::cacheFetchData(uint32_t blockNumber, uint8_t options) {
       }
     }
     m_cacheStatus = 0;
+#endif  // USE_RAM_L2_CACHE
     m_cacheBlockNumber = blockNumber;
   }
   m_cacheStatus |= options & CACHE_STATUS_MASK;
@@ -152,6 +180,24 @@ cache_t* SdVolume::cacheFetchData(uint32_t blockNumber, uint8_t options) {
 //------------------------------------------------------------------------------
 cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
   if (m_cacheFatBlockNumber != blockNumber) {
+#if USE_RAM_L2_CACHE
+    if (m_cacheFatBlockNumber != 0XFFFFFFFF) {
+      if (!cacheL2Evict(m_cacheFatBlockNumber, m_cacheFatBuffer.data,
+          (m_cacheFatStatus & CACHE_STATUS_DIRTY) | CACHE_STATUS_FAT_BLOCK)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    }
+    m_cacheFatBlockNumber = 0XFFFFFFFF;
+    m_cacheFatStatus = 0;
+    if (options & CACHE_OPTION_NO_READ) {
+      cacheL2InvalidateRange(blockNumber, 1);
+    } else if (!cacheL2Fetch(blockNumber, m_cacheFatBuffer.data,
+                             &m_cacheFatStatus)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+#else  // USE_RAM_L2_CACHE
     if (!cacheWriteFat()) {
       DBG_FAIL_MACRO;
       goto fail;
@@ -163,6 +209,7 @@ cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
       }
     }
     m_cacheFatStatus = 0;
+#endif  // USE_RAM_L2_CACHE
     m_cacheFatBlockNumber = blockNumber;
   }
   m_cacheFatStatus |= options & CACHE_STATUS_MASK;
@@ -173,7 +220,11 @@ cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheSync() {
+#if USE_RAM_L2_CACHE
+  return cacheWriteData() && cacheWriteFat() && cacheL2Flush();
+#else  // USE_RAM_L2_CACHE
   return cacheWriteData() && cacheWriteFat();
+#endif  // USE_RAM_L2_CACHE
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheWriteData() {
@@ -215,7 +266,24 @@ bool SdVolume::cacheWriteFat() {
 //------------------------------------------------------------------------------
 cache_t* SdVolume::cacheFetch(uint32_t blockNumber, uint8_t options) {
   if (m_cacheBlockNumber != blockNumber) {
-    if (!cacheSync()) {
+#if USE_RAM_L2_CACHE
+    if (m_cacheBlockNumber != 0XFFFFFFFF) {
+      if (!cacheL2Evict(m_cacheBlockNumber, m_cacheBuffer.data,
+                        m_cacheStatus & CACHE_STATUS_MASK)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    }
+    m_cacheBlockNumber = 0XFFFFFFFF;
+    m_cacheStatus = 0;
+    if (options & CACHE_OPTION_NO_READ) {
+      cacheL2InvalidateRange(blockNumber, 1);
+    } else if (!cacheL2Fetch(blockNumber, m_cacheBuffer.data, &m_cacheStatus)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+#else  // USE_RAM_L2_CACHE
+    if (!cacheWriteData()) {
       DBG_FAIL_MACRO;
       goto fail;
     }
@@ -226,6 +294,7 @@ cache_t* SdVolume::cacheFetch(uint32_t blockNumber, uint8_t options) {
       }
     }
     m_cacheStatus = 0;
+#endif  // USE_RAM_L2_CACHE
     m_cacheBlockNumber = blockNumber;
   }
   m_cacheStatus |= options & CACHE_STATUS_MASK;
@@ -240,6 +309,14 @@ cache_t* SdVolume::cacheFetchFat(uint32_t blockNumber, uint8_t options) {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheSync() {
+#if USE_RAM_L2_CACHE
+  return cacheWriteData() && cacheL2Flush();
+#else  // USE_RAM_L2_CACHE
+  return cacheWriteData();
+#endif  // USE_RAM_L2_CACHE
+}
+//------------------------------------------------------------------------------
+bool SdVolume::cacheWriteData() {
   if (m_cacheStatus & CACHE_STATUS_DIRTY) {
     if (!m_sdCard->writeBlock(m_cacheBlockNumber, m_cacheBuffer.data)) {
       DBG_FAIL_MACRO;
@@ -260,16 +337,229 @@ bool SdVolume::cacheSync() {
  fail:
   return false;
 }
-//------------------------------------------------------------------------------
-bool SdVolume::cacheWriteData() {
-  return cacheSync();
-}
 #endif  // USE_SEPARATE_FAT_CACHE
 //------------------------------------------------------------------------------
 void SdVolume::cacheInvalidate() {
     m_cacheBlockNumber = 0XFFFFFFFF;
     m_cacheStatus = 0;
 }
+#if USE_RAM_L2_CACHE
+//==============================================================================
+// RAM L2 cache.  A block that leaves L1 is moved to an L2 slot.  A block
+// that is fetched from L2 is moved to L1 so a block is never in both.
+//------------------------------------------------------------------------------
+/**
+ * Start the RAM L2 cache.
+ *
+ * \param[in] dev RAM device for the cache.
+ *
+ * \param[in] address Start of a region of RAM_L2_CACHE_SLOTS*512 bytes on
+ *            \a dev that is reserved for the cache.
+ *
+ * Dirty blocks in a previous L2 cache are written to the SD first.
+ *
+ * \return true for success or false for failure.
+ */
+bool SdVolume::cacheL2Begin(RamBaseDevice* dev, uint32_t address) {
+  if (!cacheL2Flush()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_l2Dev = dev;
+  m_l2Address = address;
+  m_l2HitCount = 0;
+  m_l2MissCount = 0;
+  cacheL2Invalidate();
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Move a block from L1 to L2.  Replace an empty slot or the least recently
+// used clean slot.  If all slots are dirty write a dirty block to the SD.
+bool SdVolume::cacheL2Evict(uint32_t block, const uint8_t* src,
+                            uint8_t status) {
+  uint8_t slot = L2_SLOT_NONE;
+  uint16_t age = 0;
+  if (m_l2Dev) {
+    for (uint8_t i = 0; i < RAM_L2_CACHE_SLOTS; i++) {
+      if (m_l2Block[i] == 0XFFFFFFFF) {
+        slot = i;
+        break;
+      }
+      if (!(m_l2Status[i] & CACHE_STATUS_DIRTY)
+        && (uint16_t)(m_l2Clock - m_l2Use[i]) >= age) {
+        age = m_l2Clock - m_l2Use[i];
+        slot = i;
+      }
+    }
+  }
+  if (slot == L2_SLOT_NONE) {
+    if (status & CACHE_STATUS_DIRTY) {
+      return cacheWriteThrough(block, src, status);
+    }
+    return true;
+  }
+  if (!m_l2Dev->write(cacheL2Address(slot), src, 512)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_l2Block[slot] = block;
+  m_l2Status[slot] = status;
+  m_l2Use[slot] = m_l2Clock++;
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Move a block from L2 to L1 or read it from the SD.
+bool SdVolume::cacheL2Fetch(uint32_t block, uint8_t* dst, uint8_t* status) {
+  uint8_t slot = cacheL2Find(block);
+  if (slot == L2_SLOT_NONE) {
+    m_l2MissCount++;
+    *status = 0;
+    return m_sdCard->readBlock(block, dst);
+  }
+  if (!m_l2Dev->read(cacheL2Address(slot), dst, 512)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_l2HitCount++;
+  *status = m_l2Status[slot] & CACHE_STATUS_DIRTY;
+  m_l2Block[slot] = 0XFFFFFFFF;
+  m_l2Status[slot] = 0;
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+uint8_t SdVolume::cacheL2Find(uint32_t block) {
+  if (m_l2Dev) {
+    for (uint8_t i = 0; i < RAM_L2_CACHE_SLOTS; i++) {
+      if (m_l2Block[i] == block) return i;
+    }
+  }
+  return L2_SLOT_NONE;
+}
+//------------------------------------------------------------------------------
+bool SdVolume::cacheL2Flush() {
+  for (uint8_t i = 0; i < RAM_L2_CACHE_SLOTS; i++) {
+    if (!cacheL2WriteBack(i)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+void SdVolume::cacheL2Invalidate() {
+  for (uint8_t i = 0; i < RAM_L2_CACHE_SLOTS; i++) {
+    m_l2Block[i] = 0XFFFFFFFF;
+    m_l2Status[i] = 0;
+  }
+}
+//------------------------------------------------------------------------------
+// Drop L2 copies of blocks that will be overwritten on the SD.
+void SdVolume::cacheL2InvalidateRange(uint32_t block, uint32_t count) {
+  for (uint8_t i = 0; i < RAM_L2_CACHE_SLOTS; i++) {
+    if ((m_l2Block[i] - block) < count) {
+      m_l2Block[i] = 0XFFFFFFFF;
+      m_l2Status[i] = 0;
+    }
+  }
+}
+//------------------------------------------------------------------------------
+// Read a block for a direct transfer.  An L2 copy is used and kept.
+bool SdVolume::cacheL2ReadBlock(uint32_t block, uint8_t* dst) {
+  uint8_t slot = cacheL2Find(block);
+  if (slot == L2_SLOT_NONE) return m_sdCard->readBlock(block, dst);
+  m_l2Use[slot] = m_l2Clock++;
+  return m_l2Dev->read(cacheL2Address(slot), dst, 512);
+}
+//------------------------------------------------------------------------------
+// Exchange the contents of an L2 slot with the L1 buffer.
+bool SdVolume::cacheL2Swap(uint8_t slot) {
+  uint8_t tmp[32];
+  uint32_t address = cacheL2Address(slot);
+  uint8_t* p = m_cacheBuffer.data;
+  for (uint16_t i = 0; i < 512; i += sizeof(tmp)) {
+    if (!m_l2Dev->read(address + i, tmp, sizeof(tmp))
+      || !m_l2Dev->write(address + i, p + i, sizeof(tmp))) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+    memcpy(p + i, tmp, sizeof(tmp));
+  }
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Write dirty L2 copies of blocks that will be read directly from the SD.
+bool SdVolume::cacheL2SyncRange(uint32_t block, uint32_t count) {
+  for (uint8_t i = 0; i < RAM_L2_CACHE_SLOTS; i++) {
+    if ((m_l2Block[i] - block) < count && !cacheL2WriteBack(i)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Write a dirty slot to the SD.  The L1 buffer is used for the transfer
+// and its contents are preserved.
+bool SdVolume::cacheL2WriteBack(uint8_t slot) {
+  uint8_t status = m_l2Status[slot];
+  if (!(status & CACHE_STATUS_DIRTY)) return true;
+  if (m_cacheBlockNumber == 0XFFFFFFFF) {
+    // L1 is empty so no swap is needed.
+    if (!m_l2Dev->read(cacheL2Address(slot), m_cacheBuffer.data, 512)
+      || !cacheWriteThrough(m_l2Block[slot], m_cacheBuffer.data, status)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  } else if (!cacheL2Swap(slot)
+    || !cacheWriteThrough(m_l2Block[slot], m_cacheBuffer.data, status)
+    || !cacheL2Swap(slot)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_l2Status[slot] = status & ~CACHE_STATUS_DIRTY;
+  return true;
+
+ fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Write a block to the SD and mirror FAT blocks to the second FAT.
+bool SdVolume::cacheWriteThrough(uint32_t block, const uint8_t* src,
+                                 uint8_t status) {
+  if (!m_sdCard->writeBlock(block, src)) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  if ((status & CACHE_STATUS_FAT_BLOCK) && m_fatCount > 1) {
+    if (!m_sdCard->writeBlock(block + m_blocksPerFat, src)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  return true;
+
+ fail:
+  return false;
+}
+#endif  // USE_RAM_L2_CACHE
 //==============================================================================
 //------------------------------------------------------------------------------
 uint32_t SdVolume::clusterStartBlock(uint32_t cluster) const {
@@ -504,6 +794,10 @@ bool SdVolume::init(Sd2Card* dev, uint8_t part) {
   m_cacheFatStatus = 0;  // cacheSync() will write block if true
   m_cacheFatBlockNumber = 0XFFFFFFFF;
 #endif  // USE_SEPARATE_FAT_CACHE
+#if USE_RAM_L2_CACHE
+  // Blocks from a previous volume are dropped without a write.
+  cacheL2Invalidate();
+#endif  // USE_RAM_L2_CACHE
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
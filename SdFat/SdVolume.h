@@ -26,6 +26,12 @@
 #include <SdFatConfig.h>
 #include <Sd2Card.h>
 #include <utility/FatStructs.h>
+#if USE_RAM_L2_CACHE
+#if USE_MULTIPLE_CARDS
+#error USE_RAM_L2_CACHE requires USE_MULTIPLE_CARDS zero
+#endif  // USE_MULTIPLE_CARDS
+#include <RamBaseDevice.h>
+#endif  // USE_RAM_L2_CACHE
 //==============================================================================
 // SdVolume class
 /**
@@ -65,6 +71,10 @@ class SdVolume {
   cache_t* cacheClear() {
     if (!cacheSync()) return 0;
     m_cacheBlockNumber = 0XFFFFFFFF;
+#if USE_RAM_L2_CACHE
+    // Raw writes may follow so drop all L2 blocks.
+    cacheL2Invalidate();
+#endif  // USE_RAM_L2_CACHE
     return &m_cacheBuffer;
   }
   /** Initialize a FAT volume.  Try partition one first then try super
@@ -115,6 +125,13 @@ class SdVolume {
    * \return true for success or false for failure
    */
   bool dbgFat(uint32_t n, uint32_t* v) {return fatGet(n, v);}
+#if USE_RAM_L2_CACHE
+  static bool cacheL2Begin(RamBaseDevice* dev, uint32_t address);
+  /** \return Number of block fetches satisfied by the L2 cache. */
+  static uint32_t cacheL2HitCount() {return m_l2HitCount;}
+  /** \return Number of block fetches read from the SD. */
+  static uint32_t cacheL2MissCount() {return m_l2MissCount;}
+#endif  // USE_RAM_L2_CACHE
 //------------------------------------------------------------------------------
  private:
   // Allow SdBaseFile access to SdVolume private data.
@@ -171,6 +188,33 @@ class SdVolume {
 #endif  // USE_SEPARATE_FAT_CACHE
   static Sd2Card* m_sdCard;            // Sd2Card object for cache
 #endif  // USE_MULTIPLE_CARDS
+#if USE_RAM_L2_CACHE
+  // RAM L2 cache.  Blocks are in L1 or L2 but never both.
+  static const uint8_t L2_SLOT_NONE = 0XFF;
+  static RamBaseDevice* m_l2Dev;      // RAM device for L2 blocks
+  static uint32_t m_l2Address;        // RAM address of first L2 block
+  static uint16_t m_l2Clock;          // LRU clock
+  static uint32_t m_l2HitCount;       // fetches from L2
+  static uint32_t m_l2MissCount;      // fetches from SD
+  static uint32_t m_l2Block[RAM_L2_CACHE_SLOTS];   // block in slot
+  static uint16_t m_l2Use[RAM_L2_CACHE_SLOTS];     // LRU time of slot
+  static uint8_t m_l2Status[RAM_L2_CACHE_SLOTS];   // CACHE_STATUS bits
+  static uint32_t cacheL2Address(uint8_t slot) {
+    return m_l2Address + 512UL*slot;
+  }
+  static bool cacheL2Evict(uint32_t block, const uint8_t* src, uint8_t status);
+  static bool cacheL2Fetch(uint32_t block, uint8_t* dst, uint8_t* status);
+  static uint8_t cacheL2Find(uint32_t block);
+  static bool cacheL2Flush();
+  static void cacheL2Invalidate();
+  static void cacheL2InvalidateRange(uint32_t block, uint32_t count);
+  static bool cacheL2ReadBlock(uint32_t block, uint8_t* dst);
+  static bool cacheL2Swap(uint8_t slot);
+  static bool cacheL2SyncRange(uint32_t block, uint32_t count);
+  static bool cacheL2WriteBack(uint8_t slot);
+  static bool cacheWriteThrough(uint32_t block, const uint8_t* src,
+                                uint8_t status);
+#endif  // USE_RAM_L2_CACHE
 
   cache_t *cacheAddress() {return &m_cacheBuffer;}
   uint32_t cacheBlockNumber() {return m_cacheBlockNumber;}
@@ -207,10 +251,20 @@ class SdVolume {
     if (m_fatType == 16) return cluster >= FAT16EOC_MIN;
     return  cluster >= FAT32EOC_MIN;
   }
+#if USE_RAM_L2_CACHE
+  bool readBlock(uint32_t block, uint8_t* dst) {
+    return cacheL2ReadBlock(block, dst);
+  }
+  bool writeBlock(uint32_t block, const uint8_t* dst) {
+    cacheL2InvalidateRange(block, 1);
+    return m_sdCard->writeBlock(block, dst);
+  }
+#else  // USE_RAM_L2_CACHE
   bool readBlock(uint32_t block, uint8_t* dst) {
     return m_sdCard->readBlock(block, dst);}
   bool writeBlock(uint32_t block, const uint8_t* dst) {
     return m_sdCard->writeBlock(block, dst);
   }
+#endif  // USE_RAM_L2_CACHE
 };
 #endif  // SdVolume